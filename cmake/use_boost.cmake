@@ -2,7 +2,7 @@
 # This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
 # code package.
 
-find_package(Boost 1.54 COMPONENTS random filesystem system REQUIRED)
+find_package(Boost 1.54 COMPONENTS random filesystem system iostreams thread REQUIRED)
 include_directories(${Boost_INCLUDE_DIRS})
 list(
   APPEND walley_LIBS
@@ -3,10 +3,19 @@
 // code package.
 
 #include "aes.hpp"
+#include "auxiliary.hpp"
 #include <crypto++/modes.h>
 #include <crypto++/aes.h>
 #include <crypto++/filters.h>
-#include <vector>
+#include <crypto++/files.h>
+#include <crypto++/pwdbased.h>
+#include <crypto++/sha.h>
+#include <crypto++/gcm.h>
+#include <boost/random/random_device.hpp>
+#include <boost/bind.hpp>
+#include <cstring>
+#include <ostream>
+#include <algorithm>
 
 namespace aes
 {
@@ -20,32 +29,437 @@ static std::vector< unsigned char > create_key(std::string const &password)
 }
 
 std::string encrypt(std::string const &password, std::string const &input)
+{
+  return encrypt(password, std::string(block_size, 0x0), input);
+}
+
+std::string decrypt(std::string const &password, std::string const &input)
+{
+  return decrypt(password, std::string(block_size, 0x0), input.data(), input.size());
+}
+
+std::string encrypt(std::string const &password, std::string const &iv, std::string const &input)
 {
   std::string output;
   std::vector< unsigned char > key = create_key(password);
-  std::vector< unsigned char > iv(CryptoPP::AES::BLOCKSIZE, 0x0);
 
   CryptoPP::AES::Encryption aes(key.data(), key.size());
-  CryptoPP::CBC_CTS_Mode_ExternalCipher::Encryption cbc(aes, iv.data());
+  CryptoPP::CBC_CTS_Mode_ExternalCipher::Encryption cbc(
+      aes, reinterpret_cast< unsigned char const * >(iv.data()));
   CryptoPP::StreamTransformationFilter filter(cbc, new CryptoPP::StringSink(output));
-  filter.Put(reinterpret_cast< unsigned char const * >(&input[0]), input.size());
+  filter.Put(reinterpret_cast< unsigned char const * >(input.data()), input.size());
   filter.MessageEnd();
 
   return output;
 }
 
-std::string decrypt(std::string const &password, std::string const &input)
+std::string decrypt(std::string const &password, std::string const &iv, char const *data,
+                    std::size_t size)
 {
   std::string output;
   std::vector< unsigned char > key = create_key(password);
-  std::vector< unsigned char > iv(CryptoPP::AES::BLOCKSIZE, 0x0);
 
   CryptoPP::AES::Decryption aes(key.data(), key.size());
-  CryptoPP::CBC_CTS_Mode_ExternalCipher::Decryption cbc(aes, iv.data());
+  CryptoPP::CBC_CTS_Mode_ExternalCipher::Decryption cbc(
+      aes, reinterpret_cast< unsigned char const * >(iv.data()));
   CryptoPP::StreamTransformationFilter filter(cbc, new CryptoPP::StringSink(output));
-  filter.Put(reinterpret_cast< unsigned char const * >(&input[0]), input.size());
+  filter.Put(reinterpret_cast< unsigned char const * >(data), size);
   filter.MessageEnd();
 
   return output;
 }
+
+std::string seal(std::string const &password, std::string const &iv, std::string const &input,
+                 std::string const &associated)
+{
+  std::vector< unsigned char > key = create_key(password);
+  std::string output(input.size() + tag_size, 0x0);
+  unsigned char *target = reinterpret_cast< unsigned char * >(&output[0]);
+
+  CryptoPP::GCM< CryptoPP::AES >::Encryption gcm;
+  gcm.SetKey(key.data(), key.size());
+  gcm.EncryptAndAuthenticate(target, target + input.size(), tag_size,
+                             reinterpret_cast< unsigned char const * >(iv.data()),
+                             static_cast< int >(iv.size()),
+                             reinterpret_cast< unsigned char const * >(associated.data()),
+                             associated.size(),
+                             reinterpret_cast< unsigned char const * >(input.data()), input.size());
+  return output;
+}
+
+std::string open(std::string const &password, std::string const &iv, char const *data,
+                 std::size_t size, std::string const &associated)
+{
+  if (size < tag_size)
+  {
+    throw integrity_error();
+  }
+
+  std::vector< unsigned char > key = create_key(password);
+  std::string output(size - tag_size, 0x0);
+  unsigned char empty = 0;
+  unsigned char *target = output.empty() ? &empty : reinterpret_cast< unsigned char * >(&output[0]);
+  unsigned char const *source = reinterpret_cast< unsigned char const * >(data);
+
+  CryptoPP::GCM< CryptoPP::AES >::Decryption gcm;
+  gcm.SetKey(key.data(), key.size());
+  if (!gcm.DecryptAndVerify(target, source + size - tag_size, tag_size,
+                            reinterpret_cast< unsigned char const * >(iv.data()),
+                            static_cast< int >(iv.size()),
+                            reinterpret_cast< unsigned char const * >(associated.data()),
+                            associated.size(), source, size - tag_size))
+  {
+    throw integrity_error();
+  }
+  return output;
+}
+
+std::string derive_key(std::string const &password, std::string const &salt,
+                       boost::uint32_t iterations)
+{
+  std::size_t const key_size = 32;
+
+  std::string output(key_size, 0x0);
+  CryptoPP::PKCS5_PBKDF2_HMAC< CryptoPP::SHA256 > kdf;
+  kdf.DeriveKey(reinterpret_cast< unsigned char * >(&output[0]), output.size(), 0,
+                reinterpret_cast< unsigned char const * >(password.data()), password.size(),
+                reinterpret_cast< unsigned char const * >(salt.data()), salt.size(), iterations);
+  return output;
+}
+
+boost::uint32_t calibrate(double seconds)
+{
+  // Given a duration, Crypto++ iterates until it has passed and reports the iterations done.
+  unsigned char output[32];
+  unsigned char const salt[block_size] = {0};
+  CryptoPP::PKCS5_PBKDF2_HMAC< CryptoPP::SHA256 > kdf;
+  std::size_t const iterations = kdf.DeriveKey(output, sizeof(output), 0, salt, sizeof(salt), salt,
+                                               sizeof(salt), 1, seconds);
+  return static_cast< boost::uint32_t >(
+      std::min< std::size_t >(std::max< std::size_t >(iterations, min_iterations), max_iterations));
+}
+
+struct encryptor::state
+{
+  state(std::string const &password, std::streambuf &output)
+      : key(create_key(password)), iv(CryptoPP::AES::BLOCKSIZE, 0x0), stream(&output),
+        aes(key.data(), key.size()), cbc(aes, iv.data()),
+        filter(cbc, new CryptoPP::FileSink(stream))
+  {
+  }
+
+  std::vector< unsigned char > key;
+  std::vector< unsigned char > iv;
+  std::ostream stream;
+  CryptoPP::AES::Encryption aes;
+  CryptoPP::CBC_CTS_Mode_ExternalCipher::Encryption cbc;
+  CryptoPP::StreamTransformationFilter filter;
+};
+
+encryptor::encryptor(std::string const &password, std::streambuf &output)
+    : cipher(new state(password, output)), buffer(chunk_size)
+{
+  setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+encryptor::~encryptor() {}
+
+void encryptor::finish()
+{
+  sync();
+  cipher->filter.MessageEnd();
+}
+
+encryptor::int_type encryptor::overflow(int_type c)
+{
+  sync();
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int encryptor::sync()
+{
+  cipher->filter.Put(reinterpret_cast< unsigned char const * >(pbase()), pptr() - pbase());
+  setp(&buffer[0], &buffer[0] + buffer.size());
+  return 0;
+}
+
+struct decryptor::state
+{
+  explicit state(std::string const &password)
+      : key(create_key(password)), iv(CryptoPP::AES::BLOCKSIZE, 0x0), aes(key.data(), key.size()),
+        cbc(aes, iv.data()), filter(cbc)
+  {
+  }
+
+  std::vector< unsigned char > key;
+  std::vector< unsigned char > iv;
+  CryptoPP::AES::Decryption aes;
+  CryptoPP::CBC_CTS_Mode_ExternalCipher::Decryption cbc;
+  CryptoPP::StreamTransformationFilter filter;
+};
+
+decryptor::decryptor(std::string const &password, char const *data, std::size_t size)
+    : cipher(new state(password)), next(data), end(data + size), buffer(chunk_size),
+      finished(false)
+{
+}
+
+decryptor::~decryptor() {}
+
+decryptor::int_type decryptor::underflow()
+{
+  // Without attached sink the filter queues its output, which is drained chunk by chunk here.
+  while (!cipher->filter.MaxRetrievable())
+  {
+    if (finished)
+    {
+      return traits_type::eof();
+    }
+
+    std::size_t const size = std::min< std::size_t >(end - next, chunk_size);
+    cipher->filter.Put(reinterpret_cast< unsigned char const * >(next), size);
+    next += size;
+    if (next == end)
+    {
+      cipher->filter.MessageEnd();
+      finished = true;
+    }
+  }
+
+  std::size_t const size =
+      cipher->filter.Get(reinterpret_cast< unsigned char * >(&buffer[0]), buffer.size());
+  setg(&buffer[0], &buffer[0], &buffer[0] + size);
+  return traits_type::to_int_type(buffer[0]);
+}
+
+struct keystream::state
+{
+  CryptoPP::CTR_Mode< CryptoPP::AES >::Encryption ctr;
+};
+
+keystream::keystream() : cipher(new state)
+{
+  unsigned char seed[32 + block_size];
+  boost::random::random_device rng;
+  for (std::size_t k = 0; k < sizeof(seed); k += 4)
+  {
+    unsigned int const bits = rng();
+    std::memcpy(seed + k, &bits, 4);
+  }
+  cipher->ctr.SetKeyWithIV(seed, 32, seed + 32, block_size);
+}
+
+keystream::~keystream() {}
+
+void keystream::generate(char *output, std::size_t size)
+{
+  unsigned char *data = reinterpret_cast< unsigned char * >(output);
+  std::memset(data, 0, size);
+  cipher->ctr.ProcessData(data, data, size);
+}
+
+/// \brief Size of a chunk including its tag.
+static std::size_t const sealed_size = sealed_chunk_size + tag_size;
+
+/// \brief Consecutive chunks passed through the cipher at once.
+struct batch
+{
+  batch(std::vector< unsigned char > const &key, char const *input, std::size_t size, char *output,
+        boost::uint64_t index, bool final, std::size_t count)
+      : key(key), input(input), size(size), output(output), index(index), final(final),
+        failed(count, 0)
+  {
+  }
+
+  void nonce(std::size_t k, unsigned char *output) const
+  {
+    std::memset(output, 0, nonce_size);
+    for (std::size_t b = 0; b < 8; ++b)
+    {
+      output[b] = static_cast< unsigned char >(((index + k) >> (8 * b)) & 0xFF);
+    }
+    output[8] = final && k + 1 == failed.size();
+  }
+
+  void encrypt(std::size_t k)
+  {
+    unsigned char iv[nonce_size];
+    nonce(k, iv);
+    std::size_t const length = std::min(sealed_chunk_size, size - k * sealed_chunk_size);
+    unsigned char *target = reinterpret_cast< unsigned char * >(output + k * sealed_size);
+    try
+    {
+      CryptoPP::GCM< CryptoPP::AES >::Encryption gcm;
+      gcm.SetKey(key.data(), key.size());
+      gcm.EncryptAndAuthenticate(
+          target, target + length, tag_size, iv, nonce_size, 0, 0,
+          reinterpret_cast< unsigned char const * >(input + k * sealed_chunk_size), length);
+    }
+    catch (std::exception const &)
+    {
+      failed[k] = 1;
+    }
+  }
+
+  void decrypt(std::size_t k)
+  {
+    unsigned char iv[nonce_size];
+    nonce(k, iv);
+    std::size_t const length = std::min(sealed_size, size - k * sealed_size) - tag_size;
+    unsigned char const *source =
+        reinterpret_cast< unsigned char const * >(input + k * sealed_size);
+    try
+    {
+      CryptoPP::GCM< CryptoPP::AES >::Decryption gcm;
+      gcm.SetKey(key.data(), key.size());
+      failed[k] = !gcm.DecryptAndVerify(
+          reinterpret_cast< unsigned char * >(output + k * sealed_chunk_size), source + length,
+          tag_size, iv, nonce_size, 0, 0, source, length);
+    }
+    catch (std::exception const &)
+    {
+      failed[k] = 1;
+    }
+  }
+
+  bool succeeded() const { return std::find(failed.begin(), failed.end(), 1) == failed.end(); }
+
+  std::vector< unsigned char > const &key;
+  char const *const input;
+  std::size_t const size;
+  char *const output;
+  boost::uint64_t const index;
+  bool const final;
+  /// \brief Flags of chunks which failed, not std::vector< bool > as it is written concurrently.
+  std::vector< char > failed;
+};
+
+/// \brief Initial size of the buffer of chunked_encryptor, which grows up to one chunk per thread.
+static std::size_t const initial_buffer_size = 1 << 16;
+
+chunked_encryptor::chunked_encryptor(std::string const &password, std::streambuf &output,
+                                     std::size_t threads)
+    : key(create_key(password)), output(output), threads(auxiliary::thread_count(threads)),
+      buffer(std::min(initial_buffer_size, this->threads * sealed_chunk_size)), index(0)
+{
+  setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+chunked_encryptor::~chunked_encryptor() {}
+
+void chunked_encryptor::finish()
+{
+  seal(true);
+}
+
+chunked_encryptor::int_type chunked_encryptor::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    return traits_type::not_eof(c);
+  }
+
+  // Small payloads never allocate a full batch, the buffer only grows as data arrives. Sealing
+  // waits for a full batch, whose size is a multiple of the chunk size.
+  std::size_t const capacity = threads * sealed_chunk_size;
+  if (buffer.size() < capacity)
+  {
+    std::size_t const size = pptr() - pbase();
+    buffer.resize(std::min(buffer.size() * 2, capacity));
+    setp(&buffer[0], &buffer[0] + buffer.size());
+    pbump(static_cast< int >(size));
+  }
+  else
+  {
+    // More data follows, so none of the buffered chunks is the last one.
+    seal(false);
+  }
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+void chunked_encryptor::seal(bool final)
+{
+  std::size_t const size = pptr() - pbase();
+  std::size_t count = (size + sealed_chunk_size - 1) / sealed_chunk_size;
+  if (final && !count)
+  {
+    count = 1;
+  }
+
+  std::size_t const total = size + count * tag_size;
+  if (sealed.size() < total)
+  {
+    sealed.resize(total);
+  }
+
+  batch chunks(key, pbase(), size, &sealed[0], index, final, count);
+  auxiliary::parallel_for(threads, count, boost::bind(&batch::encrypt, &chunks, _1));
+  if (!chunks.succeeded())
+  {
+    throw integrity_error();
+  }
+
+  if (output.sputn(&sealed[0], total) != static_cast< std::streamsize >(total))
+  {
+    throw std::ios_base::failure("cannot write ciphertext");
+  }
+  index += count;
+  setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+// A batch never holds more chunks than there are, nor more plaintext than there is ciphertext.
+chunked_decryptor::chunked_decryptor(std::string const &password, char const *data,
+                                     std::size_t size, std::size_t threads)
+    : key(create_key(password)), begin(data), end(data + size),
+      threads(std::min(auxiliary::thread_count(threads),
+                       std::max< std::size_t >((size + sealed_size - 1) / sealed_size, 1))),
+      buffer(std::min(this->threads * sealed_chunk_size, size)), index(0)
+{
+}
+
+chunked_decryptor::~chunked_decryptor() {}
+
+chunked_decryptor::int_type chunked_decryptor::underflow()
+{
+  std::size_t const total = (end - begin + sealed_size - 1) / sealed_size;
+  if (!total)
+  {
+    throw integrity_error();
+  }
+  if (index == total)
+  {
+    return traits_type::eof();
+  }
+
+  std::size_t const count = std::min< std::size_t >(total - index, threads);
+  char const *const next = begin + index * sealed_size;
+  std::size_t const size = std::min< std::size_t >(end - next, count * sealed_size);
+  if ((size - 1) % sealed_size + 1 < tag_size)
+  {
+    throw integrity_error();
+  }
+
+  batch chunks(key, next, size, &buffer[0], index, index + count == total, count);
+  auxiliary::parallel_for(threads, count, boost::bind(&batch::decrypt, &chunks, _1));
+  if (!chunks.succeeded())
+  {
+    throw integrity_error();
+  }
+
+  index += count;
+  std::size_t const length = size - count * tag_size;
+  if (!length)
+  {
+    return underflow();
+  }
+  setg(&buffer[0], &buffer[0], &buffer[0] + length);
+  return traits_type::to_int_type(buffer[0]);
+}
 }
@@ -5,10 +5,30 @@
 #ifndef BACKEND_AES_HPP_INCLUDED
 #define BACKEND_AES_HPP_INCLUDED
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
 #include <string>
+#include <vector>
+#include <streambuf>
+#include <stdexcept>
 
 namespace aes
 {
+/// \brief Size of the chunks passed through the cipher by the stream buffers.
+std::size_t const chunk_size = 1 << 16;
+
+/// \brief Cipher block size, which is also the size of initialization vectors.
+std::size_t const block_size = 16;
+
+/// \brief Size of the chunks authenticated individually by chunked_encryptor.
+std::size_t const sealed_chunk_size = 1 << 20;
+
+/// \brief Size of the authentication tag following each chunk of chunked_encryptor.
+std::size_t const tag_size = 16;
+
+/// \brief Size of the nonces of authenticated encryption, see seal().
+std::size_t const nonce_size = 12;
+
 /// \brief Encrypt data blob with AES chiffre.
 ///
 /// Outputs the encrypted data from given input data using the given password as key rightpadded by
@@ -28,6 +48,228 @@ std::string encrypt(std::string const &password, std::string const &input);
 /// \param[in] input Data to be decrypted
 /// \return Decrypted data
 std::string decrypt(std::string const &password, std::string const &input);
+
+/// \brief Encrypt data blob with AES chiffre and an explicit initialization vector.
+///
+/// Like encrypt(), but suitable for encrypting many blobs with the same password, given that each
+/// of them uses a distinct random initialization vector.
+///
+/// \param[in] password Key to be used for encryption
+/// \param[in] iv Initialization vector of block_size bytes
+/// \param[in] input Data to be encrypted
+/// \return Encrypted data
+std::string encrypt(std::string const &password, std::string const &iv, std::string const &input);
+
+/// \brief Decrypt data blob with AES chiffre and an explicit initialization vector.
+///
+/// \param[in] password Key to be used for decryption
+/// \param[in] iv Initialization vector of block_size bytes
+/// \param[in] data Beginning of data to be decrypted
+/// \param[in] size Size of data to be decrypted
+/// \return Decrypted data
+std::string decrypt(std::string const &password, std::string const &iv, char const *data,
+                    std::size_t size);
+
+/// \brief Encrypt and authenticate data blob with AES-GCM.
+///
+/// The ciphertext is followed by a tag of tag_size bytes, which also covers the `associated` data
+/// stored elsewhere. An initialization vector must never be used twice with the same key.
+///
+/// \param[in] password Key to be used for encryption
+/// \param[in] iv Initialization vector, usually a nonce of nonce_size bytes
+/// \param[in] input Data to be encrypted
+/// \param[in] associated Data to be authenticated along with `input`
+/// \return Encrypted data followed by tag
+std::string seal(std::string const &password, std::string const &iv, std::string const &input,
+                 std::string const &associated = std::string());
+
+/// \brief Decrypt and verify data blob encrypted by seal().
+///
+/// Throws integrity_error if the data or the associated data has been tampered with, or if key
+/// or initialization vector are wrong.
+///
+/// \param[in] password Key to be used for decryption
+/// \param[in] iv Initialization vector the data was encrypted with
+/// \param[in] data Beginning of encrypted data followed by tag
+/// \param[in] size Size of encrypted data including tag
+/// \param[in] associated Data authenticated along with the encrypted data
+/// \return Decrypted data
+std::string open(std::string const &password, std::string const &iv, char const *data,
+                 std::size_t size, std::string const &associated = std::string());
+
+/// \brief Derive a key from a password with PBKDF2-HMAC-SHA256.
+///
+/// The derived key can be passed as password to the other functions of this module, where it is
+/// used as it is.
+///
+/// \param[in] password Password to derive the key from
+/// \param[in] salt Random salt, stored alongside the data encrypted with the key
+/// \param[in] iterations Work factor, see calibrate()
+/// \return Derived key of 256 bits
+std::string derive_key(std::string const &password, std::string const &salt,
+                       boost::uint32_t iterations);
+
+/// \brief Number of derive_key() iterations taking about the given time on this machine.
+///
+/// \param[in] seconds Desired duration of a key derivation
+/// \return Number of iterations, at least min_iterations and at most max_iterations
+boost::uint32_t calibrate(double seconds);
+
+/// \brief Lower bound for results of calibrate().
+boost::uint32_t const min_iterations = 10000;
+
+/// \brief Upper bound for results of calibrate() and work factors read from stores.
+///
+/// Deriving a key with this many iterations takes several seconds already, stores asking for more
+/// are taken as corrupt rather than left to hang while opening.
+boost::uint32_t const max_iterations = 1 << 24;
+
+/// \brief Stream buffer encrypting everything written to it.
+///
+/// Data is collected in a buffer of chunk_size bytes, then passed through the cipher and written to
+/// the output buffer, so memory usage does not depend on the amount of data. The ciphertext is
+/// identical to the one produced by encrypt(). Call finish() after the last write, otherwise the
+/// ciphertext is incomplete.
+class encryptor : public std::streambuf
+{
+public:
+  /// \brief Encrypt with the given password into `output`.
+  encryptor(std::string const &password, std::streambuf &output);
+  ~encryptor();
+
+  /// \brief Encrypt any buffered data and write the final blocks.
+  void finish();
+
+protected:
+  int_type overflow(int_type c);
+  int sync();
+
+private:
+  struct state;
+  boost::scoped_ptr< state > cipher;
+  std::vector< char > buffer;
+};
+
+/// \brief Cryptographically secure pseudo random bytes for bulk use.
+///
+/// AES in counter mode under a key and initial counter drawn from the system's random device, so
+/// large amounts of random data cost one cipher pass instead of one system call per byte.
+class keystream
+{
+public:
+  /// \brief Seed a new keystream from the system's random device.
+  keystream();
+  ~keystream();
+
+  /// \brief Fill `size` bytes starting at `output` with the next bytes of the keystream.
+  void generate(char *output, std::size_t size);
+
+private:
+  struct state;
+  boost::scoped_ptr< state > cipher;
+};
+
+/// \brief Stream buffer decrypting a ciphertext in memory.
+///
+/// The ciphertext is passed to the cipher straight from the given memory, chunk_size bytes at a
+/// time as the plaintext is consumed, so neither is ever copied as a whole. This makes it suitable
+/// for memory mapped files. Reads the ciphertext produced by encrypt() or encryptor. Cipher errors
+/// are thrown from the reading functions.
+class decryptor : public std::streambuf
+{
+public:
+  /// \brief Decrypt `size` bytes starting at `data` with the given password.
+  ///
+  /// The memory must outlive the buffer.
+  decryptor(std::string const &password, char const *data, std::size_t size);
+  ~decryptor();
+
+protected:
+  int_type underflow();
+
+private:
+  struct state;
+  boost::scoped_ptr< state > cipher;
+  char const *next;
+  char const *end;
+  std::vector< char > buffer;
+  bool finished;
+};
+
+/// \brief Stream buffer encrypting everything written to it in parallel.
+///
+/// Data is split into chunks of sealed_chunk_size bytes, each encrypted and authenticated with
+/// AES-GCM under a nonce made of its index and a flag marking the last chunk, and followed by its
+/// tag. As chunks do not depend on each other, batches of them are encrypted on several threads.
+/// Every ciphertext must use a fresh key, as the nonces repeat for equal indices. Call finish()
+/// after the last write, otherwise the ciphertext is incomplete.
+class chunked_encryptor : public std::streambuf
+{
+public:
+  /// \brief Encrypt with the given key into `output`.
+  ///
+  /// \param[in] password Key to be used for encryption
+  /// \param[out] output Buffer the ciphertext is written to
+  /// \param[in] threads Number of threads, one per hardware thread if 0
+  chunked_encryptor(std::string const &password, std::streambuf &output, std::size_t threads = 0);
+  ~chunked_encryptor();
+
+  /// \brief Encrypt any buffered data as the last chunk.
+  void finish();
+
+protected:
+  int_type overflow(int_type c);
+
+private:
+  void seal(bool final);
+
+  std::vector< unsigned char > const key;
+  std::streambuf &output;
+  std::size_t const threads;
+  std::vector< char > buffer;
+  std::vector< char > sealed;
+  boost::uint64_t index;
+};
+
+/// \brief Stream buffer decrypting a ciphertext of chunked_encryptor in memory in parallel.
+///
+/// Batches of chunks are decrypted on several threads as the plaintext is consumed. A chunk with
+/// a wrong tag, a missing last chunk or chunks in the wrong order throw integrity_error from the
+/// reading functions.
+class chunked_decryptor : public std::streambuf
+{
+public:
+  /// \brief Decrypt `size` bytes starting at `data` with the given key.
+  ///
+  /// The memory must outlive the buffer.
+  ///
+  /// \param[in] password Key to be used for decryption
+  /// \param[in] data Beginning of ciphertext
+  /// \param[in] size Size of ciphertext
+  /// \param[in] threads Number of threads, one per hardware thread if 0
+  chunked_decryptor(std::string const &password, char const *data, std::size_t size,
+                    std::size_t threads = 0);
+  ~chunked_decryptor();
+
+protected:
+  int_type underflow();
+
+private:
+  std::vector< unsigned char > const key;
+  char const *const begin;
+  char const *const end;
+  std::size_t const threads;
+  std::vector< char > buffer;
+  boost::uint64_t index;
+};
+
+/// \brief Error to be thrown if a chunked ciphertext has been tampered with or truncated.
+class integrity_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  integrity_error() : std::runtime_error("ciphertext failed authentication") {}
+};
 }
 
 #endif // BACKEND_AES_HPP_INCLUDED
@@ -0,0 +1,265 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "autofill.hpp"
+#include <boost/foreach.hpp>
+#include <algorithm>
+
+namespace autofill
+{
+/// \brief Labels of a host in reverse order, the top level domain first.
+static std::vector< std::string > reverse_labels(std::string const &host)
+{
+  std::vector< std::string > output;
+  if (!host.empty() && host[0] == '[')
+  {
+    output.push_back(host);
+    return output;
+  }
+
+  // Empty labels of leading, doubled or trailing dots are skipped.
+  std::size_t end = host.size();
+  while (end)
+  {
+    std::size_t const dot = host.rfind('.', end - 1);
+    std::size_t const begin = dot == std::string::npos ? 0 : dot + 1;
+    if (begin < end)
+    {
+      output.push_back(host.substr(begin, end - begin));
+    }
+    end = dot == std::string::npos ? 0 : dot;
+  }
+  return output;
+}
+
+static bool ipv4_address(std::vector< std::string > const &labels)
+{
+  if (labels.size() != 4)
+  {
+    return false;
+  }
+  BOOST_FOREACH (std::string const &label, labels)
+  {
+    if (label.empty() || label.find_first_not_of("0123456789") != std::string::npos)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// \brief Number of labels of the registrable domain, see registrable_domain().
+///
+/// Exceeds the number of labels of hosts that are public suffixes.
+static std::size_t registrable_size(std::vector< std::string > const &labels)
+{
+  static char const *const second_levels[] = {"ac", "co", "com", "edu", "go",
+                                              "gov", "ne", "net", "or", "org"};
+  static char const *const *const second_levels_end =
+      second_levels + sizeof(second_levels) / sizeof(*second_levels);
+
+  if (labels.size() < 2 || ipv4_address(labels))
+  {
+    return labels.size();
+  }
+  // A host like `co.uk` is a suffix itself, which the larger size keeps from matching as domain.
+  if (labels[0].size() == 2 &&
+      std::find(second_levels, second_levels_end, labels[1]) != second_levels_end)
+  {
+    return 3;
+  }
+  return 2;
+}
+
+static char const whitespace[] = " \t\r\n";
+
+std::string scheme(std::string const &url)
+{
+  std::size_t const begin = url.find_first_not_of(whitespace);
+  std::size_t const end = url.find("://");
+  if (begin == std::string::npos || end == std::string::npos || end <= begin ||
+      end > url.find_first_of("/?#", begin))
+  {
+    return std::string();
+  }
+
+  std::string output;
+  BOOST_FOREACH (char c, url.substr(begin, end - begin))
+  {
+    output.push_back(c >= 'A' && c <= 'Z' ? static_cast< char >(c - 'A' + 'a') : c);
+  }
+  return output;
+}
+
+std::string host(std::string const &url)
+{
+
+  std::size_t begin = url.find_first_not_of(whitespace);
+  if (begin == std::string::npos)
+  {
+    return std::string();
+  }
+  std::size_t const last = url.find_last_not_of(whitespace) + 1;
+
+  std::size_t const separator = url.find("://", begin);
+  if (separator != std::string::npos && separator < url.find_first_of("/?#", begin))
+  {
+    begin = separator + 3;
+  }
+  std::string const authority =
+      url.substr(begin, std::min(url.find_first_of("/?#", begin), last) - begin);
+
+  std::size_t start = authority.rfind('@');
+  start = start == std::string::npos ? 0 : start + 1;
+  std::size_t stop = std::string::npos;
+  if (start < authority.size() && authority[start] == '[')
+  {
+    stop = authority.find(']', start);
+    stop = stop == std::string::npos ? stop : stop + 1;
+  }
+  else
+  {
+    stop = authority.find(':', start);
+  }
+
+  std::string output;
+  BOOST_FOREACH (char c, authority.substr(start, stop == std::string::npos ? stop : stop - start))
+  {
+    if (c >= 'A' && c <= 'Z')
+    {
+      c = static_cast< char >(c - 'A' + 'a');
+    }
+    if (c != '.' || (!output.empty() && output[output.size() - 1] != '.'))
+    {
+      output.push_back(c);
+    }
+  }
+  if (!output.empty() && output[output.size() - 1] == '.')
+  {
+    output.erase(output.size() - 1);
+  }
+  return output;
+}
+
+std::string registrable_domain(std::string const &host)
+{
+  std::vector< std::string > const labels = reverse_labels(host);
+  std::string output;
+  for (std::size_t k = std::min(registrable_size(labels), labels.size()); k > 0; --k)
+  {
+    output += labels[k - 1];
+    if (k > 1)
+    {
+      output += '.';
+    }
+  }
+  return output;
+}
+
+index::index() : nodes(1) {}
+
+void index::insert(std::string const &uid, std::string const &url)
+{
+  erase(uid);
+
+  std::vector< std::string > const labels = reverse_labels(host(url));
+  if (labels.empty())
+  {
+    return;
+  }
+
+  std::size_t position = 0;
+  BOOST_FOREACH (std::string const &label, labels)
+  {
+    boost::unordered_map< std::string, std::size_t >::const_iterator it =
+        nodes[position].children.find(label);
+    if (it == nodes[position].children.end())
+    {
+      // Growing the nodes invalidates references into them, so only positions are kept.
+      nodes.push_back(node());
+      it = nodes[position].children.insert(std::make_pair(label, nodes.size() - 1)).first;
+    }
+    position = it->second;
+  }
+  nodes[position].uids.push_back(uid);
+  entries[uid] = position;
+  if (scheme(url) == "https")
+  {
+    secure.insert(uid);
+  }
+}
+
+void index::erase(std::string const &uid)
+{
+  boost::unordered_map< std::string, std::size_t >::iterator it = entries.find(uid);
+  if (it != entries.end())
+  {
+    std::vector< std::string > &uids = nodes[it->second].uids;
+    uids.erase(std::find(uids.begin(), uids.end(), uid));
+    entries.erase(it);
+    secure.erase(uid);
+  }
+}
+
+std::vector< std::string > index::find(std::string const &url, match_type match) const
+{
+  std::vector< std::string > output = find_host(url, match);
+  std::string const page = scheme(url);
+  if (secure.empty() || page.empty() || page == "https")
+  {
+    return output;
+  }
+
+  std::vector< std::string > insecure;
+  BOOST_FOREACH (std::string const &uid, output)
+  {
+    if (!secure.count(uid))
+    {
+      insecure.push_back(uid);
+    }
+  }
+  return insecure;
+}
+
+std::vector< std::string > index::find_host(std::string const &url, match_type match) const
+{
+  std::vector< std::string > output;
+  std::vector< std::string > const labels = reverse_labels(host(url));
+  std::size_t const domain = registrable_size(labels);
+
+  std::size_t position = 0;
+  for (std::size_t k = 0; k < labels.size(); ++k)
+  {
+    boost::unordered_map< std::string, std::size_t >::const_iterator it =
+        nodes[position].children.find(labels[k]);
+    if (it == nodes[position].children.end())
+    {
+      return output;
+    }
+    position = it->second;
+
+    if (k + 1 == domain && match == MATCH_DOMAIN)
+    {
+      collect(position, output);
+      return output;
+    }
+    if ((k + 1 >= domain && match == MATCH_PARENT_DOMAINS) || k + 1 == labels.size())
+    {
+      output.insert(output.end(), nodes[position].uids.begin(), nodes[position].uids.end());
+    }
+  }
+  return output;
+}
+
+void index::collect(std::size_t position, std::vector< std::string > &output) const
+{
+  output.insert(output.end(), nodes[position].uids.begin(), nodes[position].uids.end());
+  for (boost::unordered_map< std::string, std::size_t >::const_iterator it =
+           nodes[position].children.begin();
+       it != nodes[position].children.end(); ++it)
+  {
+    collect(it->second, output);
+  }
+}
+}
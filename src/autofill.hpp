@@ -0,0 +1,105 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_AUTOFILL_HPP_INCLUDED
+#define BACKEND_AUTOFILL_HPP_INCLUDED
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <string>
+#include <vector>
+
+/// \brief Matching of logins to the page they are used on by host name.
+namespace autofill
+{
+/// \brief Ways a host of a login may match the host of a page.
+enum match_type
+{
+  /// \brief Same host only.
+  MATCH_HOST,
+  /// \brief Same host, or a parent domain of the page down to its registrable domain.
+  MATCH_PARENT_DOMAINS,
+  /// \brief Any host within the registrable domain of the page.
+  ///
+  /// Leaks entries between hosts of public suffixes missing from the approximation of
+  /// registrable_domain(), like the sites of different users of `github.io`.
+  MATCH_DOMAIN
+};
+
+/// \brief Normalized host of a URL.
+///
+/// Scheme, user information, port, path, query and fragment are removed, letters are converted to
+/// lower case and empty labels of leading, doubled or trailing dots are dropped. Input without
+/// scheme is taken as host followed by an optional path, like `example.com/login`.
+///
+/// \param[in] url URL to take the host from
+/// \return Host, empty if there is none
+std::string host(std::string const &url);
+
+/// \brief Scheme of a URL in lower case, empty if there is none.
+///
+/// \param[in] url URL to take the scheme from
+/// \return Scheme
+std::string scheme(std::string const &url);
+
+/// \brief Registrable domain of a host, the part of it an owner registers.
+///
+/// Without a public suffix list this is approximated by the last two labels, or the last three
+/// labels for common second level registrations under country codes like `co.uk`. IP addresses,
+/// single labels and such suffixes themselves are registrable domains of their own.
+///
+/// \param[in] host Normalized host, see host()
+/// \return Registrable domain
+std::string registrable_domain(std::string const &host);
+
+/// \brief Index of unique ids by the host of their URL.
+///
+/// Hosts are stored in a trie of their labels in reverse order, so all hosts of a domain are found
+/// in the subtree of its node. Lookups only depend on the number of labels of the page and the
+/// number of matches, not on the number of entries.
+class index
+{
+public:
+  index();
+
+  /// \brief Add an entry, or replace the URL of the entry with the same id.
+  ///
+  /// URLs without a host are not indexed.
+  void insert(std::string const &uid, std::string const &url);
+
+  /// \brief Remove an entry if present.
+  void erase(std::string const &uid);
+
+  /// \brief Unique ids of all entries matching a page.
+  ///
+  /// Entries with an `https` URL only match pages of the same or no scheme.
+  ///
+  /// \param[in] url URL of the page
+  /// \param[in] match Kind of match
+  /// \return Unique ids of matching entries
+  std::vector< std::string > find(std::string const &url, match_type match) const;
+
+private:
+  /// \brief Unique ids of all entries matching the host of a page, regardless of the scheme.
+  std::vector< std::string > find_host(std::string const &url, match_type match) const;
+
+  /// \brief Node of the trie, its path from the root spells a host in reverse label order.
+  struct node
+  {
+    boost::unordered_map< std::string, std::size_t > children;
+    std::vector< std::string > uids;
+  };
+
+  void collect(std::size_t position, std::vector< std::string > &output) const;
+
+  /// \brief Nodes by position, the root is first.
+  std::vector< node > nodes;
+  /// \brief Node of each entry by its unique id.
+  boost::unordered_map< std::string, std::size_t > entries;
+  /// \brief Unique ids of the entries with an `https` URL.
+  boost::unordered_set< std::string > secure;
+};
+}
+
+#endif // BACKEND_AUTOFILL_HPP_INCLUDED
@@ -3,73 +3,418 @@
 // code package.
 
 #include "auxiliary.hpp"
-#include <boost/random/random_device.hpp>
-#include <boost/random/uniform_int_distribution.hpp>
+#include "aes.hpp"
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
 #include <fstream>
+#include <sstream>
 #include <vector>
-#include <climits>
+#include <set>
+#include <cerrno>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define AUXILIARY_POSIX 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 namespace auxiliary
 {
 std::string generate_password(std::size_t length, std::string const &special_characters)
 {
-  std::string alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890";
-  alphabet += special_characters;
-  std::string output(length, 0x0);
+  return password_generator(special_characters)(length);
+}
 
-  boost::random::random_device rng;
-  boost::random::uniform_int_distribution<> index_dist(0, alphabet.size() - 1);
-  for (std::size_t k = 0; k < length; ++k)
+std::vector< std::string > generate_passwords(std::size_t count, std::size_t length,
+                                              std::string const &special_characters)
+{
+  password_generator generator(special_characters);
+  std::vector< std::string > output;
+  output.reserve(count);
+  while (output.size() < count)
   {
-    output[k] = alphabet[index_dist(rng)];
+    output.push_back(generator(length));
   }
+  return output;
+}
 
+/// \brief Characters of `characters` in order of first occurrence.
+static std::string unique_characters(std::string const &characters)
+{
+  bool used[256] = {};
+  std::string output;
+  BOOST_FOREACH (char character, characters)
+  {
+    unsigned char const index = static_cast< unsigned char >(character);
+    if (!used[index])
+    {
+      used[index] = true;
+      output += character;
+    }
+  }
   return output;
 }
 
-void secure_erase(std::string const &filename, std::size_t iterations)
+password_generator::password_generator(std::string const &special_characters)
+    : alphabet(unique_characters("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890" +
+                                 special_characters)),
+      limit(256 - 256 % alphabet.size()), random(new aes::keystream), position(0)
 {
-  std::fstream file(filename.c_str(), std::fstream::in | std::fstream::out | std::fstream::binary);
-  if (file)
+}
+
+password_generator::~password_generator() {}
+
+std::string password_generator::operator()(std::size_t length)
+{
+  std::string output(length, 0x0);
+  for (std::size_t k = 0; k < length; ++k)
+  {
+    output[k] = alphabet[next()];
+  }
+  return output;
+}
+
+std::size_t password_generator::next()
+{
+  for (;;)
+  {
+    if (position == buffer.size())
+    {
+      // Grow the buffer with use, so single passwords do not pay for a large refill.
+      buffer.resize(std::min< std::size_t >(std::max< std::size_t >(2 * buffer.size(), 64), 4096));
+      random->generate(reinterpret_cast< char * >(&buffer[0]), buffer.size());
+      position = 0;
+    }
+
+    unsigned int const value = buffer[position++];
+    if (value < limit)
+    {
+      return static_cast< std::size_t >(value % alphabet.size());
+    }
+  }
+}
+
+#ifdef AUXILIARY_POSIX
+/// \brief File overwritten in place by secure_erase(), using positional writes.
+class erase_target
+{
+public:
+  explicit erase_target(std::string const &filename)
+      : fd(open(filename.c_str(), O_WRONLY)), length(0)
   {
-    file.seekg(0, std::fstream::end);
-    std::size_t file_length = static_cast< std::size_t >(file.tellg());
-    file.seekg(0, std::fstream::beg);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+      close();
+      throw file_access_error();
+    }
+    length = static_cast< boost::uint64_t >(status.st_size);
+  }
 
-    boost::random::random_device rng;
-    boost::random::uniform_int_distribution<> index_dist(CHAR_MIN, CHAR_MAX);
-    std::vector< char > random_data(file_length, 0x0);
+  ~erase_target()
+  {
+    close();
+  }
 
-    while (iterations--)
+  boost::uint64_t size() const
+  {
+    return length;
+  }
+
+  void write(boost::uint64_t offset, char const *data, std::size_t size)
+  {
+    while (size)
     {
-      BOOST_FOREACH (char &c, random_data)
+      ssize_t const written = pwrite(fd, data, size, static_cast< off_t >(offset));
+      if (written < 0 && errno == EINTR)
       {
-        c = static_cast< char >(index_dist(rng));
+        continue;
       }
-      file.write(random_data.data(), random_data.size());
-      file.seekg(0, std::fstream::beg);
+      else if (written <= 0)
+      {
+        throw file_access_error();
+      }
+      data += written;
+      offset += static_cast< boost::uint64_t >(written);
+      size -= static_cast< std::size_t >(written);
     }
-    file.close();
+  }
 
-    try
+  void sync()
+  {
+    if (fsync(fd) != 0)
     {
-      boost::filesystem::remove(filename);
+      throw file_access_error();
     }
-    catch (std::exception const &)
+  }
+
+private:
+  void close()
+  {
+    if (fd >= 0)
+    {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  int fd;
+  boost::uint64_t length;
+};
+#else
+/// \brief File overwritten in place by secure_erase(), using seek and write.
+class erase_target
+{
+public:
+  explicit erase_target(std::string const &filename)
+      : file(filename.c_str(), std::fstream::in | std::fstream::out | std::fstream::binary),
+        length(0)
+  {
+    if (!file || !file.seekg(0, std::fstream::end))
     {
       throw file_access_error();
     }
+    length = static_cast< boost::uint64_t >(file.tellg());
+  }
+
+  boost::uint64_t size() const
+  {
+    return length;
   }
-  else
+
+  void write(boost::uint64_t offset, char const *data, std::size_t size)
+  {
+    if (!file.seekp(static_cast< std::streamoff >(offset)) ||
+        !file.write(data, static_cast< std::streamsize >(size)))
+    {
+      throw file_access_error();
+    }
+  }
+
+  void sync()
+  {
+    if (!file.flush())
+    {
+      throw file_access_error();
+    }
+  }
+
+private:
+  std::fstream file;
+  boost::uint64_t length;
+};
+#endif
+
+void secure_erase(std::string const &filename, std::size_t iterations)
+{
+  secure_erase(filename, std::vector< std::string >(iterations));
+}
+
+void secure_erase(std::string const &filename, std::vector< std::string > const &patterns)
+{
+  std::size_t const buffer_size = 1 << 20;
+
+  {
+    erase_target file(filename);
+    boost::uint64_t const file_size = file.size();
+    std::vector< char > buffer(
+        static_cast< std::size_t >(std::min< boost::uint64_t >(buffer_size, file_size)));
+    boost::scoped_ptr< aes::keystream > random;
+
+    BOOST_FOREACH (std::string const &pattern, patterns)
+    {
+      // Fixed patterns fitting the buffer are laid out once, with a step keeping them aligned
+      // across chunks. Longer ones are laid out per chunk, continuing where the last one ended.
+      std::size_t step = buffer.size();
+      bool const repeated = !pattern.empty() && pattern.size() <= buffer.size();
+      if (pattern.empty())
+      {
+        if (!random)
+        {
+          random.reset(new aes::keystream);
+        }
+      }
+      else if (repeated)
+      {
+        for (std::size_t k = 0; k < buffer.size(); ++k)
+        {
+          buffer[k] = pattern[k % pattern.size()];
+        }
+        step -= buffer.size() % pattern.size();
+      }
+
+      for (boost::uint64_t offset = 0; offset < file_size;)
+      {
+        std::size_t const size =
+            static_cast< std::size_t >(std::min< boost::uint64_t >(step, file_size - offset));
+        if (pattern.empty())
+        {
+          random->generate(&buffer[0], size);
+        }
+        else if (!repeated)
+        {
+          std::size_t phase = static_cast< std::size_t >(offset % pattern.size());
+          for (std::size_t k = 0; k < size; ++k)
+          {
+            buffer[k] = pattern[phase];
+            phase = phase + 1 == pattern.size() ? 0 : phase + 1;
+          }
+        }
+        file.write(offset, &buffer[0], size);
+        offset += size;
+      }
+      file.sync();
+    }
+  }
+
+  try
+  {
+    boost::filesystem::remove(filename);
+  }
+  catch (std::exception const &)
   {
     throw file_access_error();
   }
 }
 
-std::string map_file(std::string const &content)
+#if defined(__linux__) && defined(SYS_memfd_create)
+/// \brief Prefix of the paths of in-memory files owned by this process.
+static std::string memory_file_prefix()
 {
+  std::ostringstream prefix;
+  prefix << "/proc/" << getpid() << "/fd/";
+  return prefix.str();
+}
+
+/// \brief Descriptors of the in-memory files created by map_memory_file() and not yet released.
+///
+/// Only these are ever truncated and closed, as any other descriptor of the same number may belong
+/// to a file of someone else. Files still open at exit are released then.
+static struct memory_files
+{
+  ~memory_files()
+  {
+    BOOST_FOREACH (int fd, descriptors)
+    {
+      close(fd);
+    }
+  }
+
+  boost::mutex mutex;
+  std::set< int > descriptors;
+} owned_memory_files;
+
+/// \brief Create an anonymous in-memory file holding `content`.
+///
+/// \return Path to the file, or an empty string if in-memory files are not supported
+static std::string map_memory_file(std::string const &content)
+{
+  unsigned int const close_on_exec = 0x0001U; // MFD_CLOEXEC
+  int const fd = static_cast< int >(syscall(SYS_memfd_create, "walley", close_on_exec));
+  if (fd < 0)
+  {
+    return std::string();
+  }
+
+  char const *data = content.data();
+  std::size_t remaining = content.size();
+  while (remaining)
+  {
+    ssize_t const written = write(fd, data, remaining);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (written <= 0)
+    {
+      close(fd);
+      throw file_access_error();
+    }
+    data += written;
+    remaining -= static_cast< std::size_t >(written);
+  }
+
+  {
+    boost::lock_guard< boost::mutex > lock(owned_memory_files.mutex);
+    owned_memory_files.descriptors.insert(fd);
+  }
+
+  std::ostringstream path;
+  path << memory_file_prefix() << fd;
+  return path.str();
+}
+
+/// \brief Release an in-memory file created by map_memory_file().
+///
+/// Paths of descriptors not created by map_memory_file(), or already released, are rejected, as
+/// erasing them like files on disk would overwrite whatever file the descriptor refers to now.
+///
+/// \return Whether `filename` referred to such a file
+static bool unmap_memory_file(std::string const &filename)
+{
+  std::string const prefix = memory_file_prefix();
+  if (filename.compare(0, prefix.size(), prefix) != 0)
+  {
+    return false;
+  }
+
+  int fd = -1;
+  std::istringstream stream(filename.substr(prefix.size()));
+  if (!(stream >> fd) || !stream.eof())
+  {
+    throw file_access_error();
+  }
+
+  {
+    boost::lock_guard< boost::mutex > lock(owned_memory_files.mutex);
+    if (!owned_memory_files.descriptors.erase(fd))
+    {
+      throw file_access_error();
+    }
+  }
+  if (ftruncate(fd, 0) != 0 || close(fd) != 0)
+  {
+    throw file_access_error();
+  }
+  return true;
+}
+#else
+static std::string map_memory_file(std::string const &)
+{
+  return std::string();
+}
+
+static bool unmap_memory_file(std::string const &)
+{
+  return false;
+}
+#endif
+
+std::string map_file(std::string const &content, bool in_memory)
+{
+  if (in_memory)
+  {
+    std::string const path = map_memory_file(content);
+    if (!path.empty())
+    {
+      return path;
+    }
+  }
+
   boost::filesystem::path temp = boost::filesystem::unique_path();
   std::ofstream file(temp.native().c_str(), std::ofstream::binary);
   if (file)
@@ -80,4 +425,232 @@ std::string map_file(std::string const &content)
   }
   throw file_access_error();
 }
+
+void unmap_file(std::string const &filename, std::size_t iterations)
+{
+  if (!unmap_memory_file(filename))
+  {
+    secure_erase(filename, iterations);
+  }
+}
+
+std::size_t thread_count(std::size_t threads)
+{
+  if (threads)
+  {
+    return threads;
+  }
+  return std::max< std::size_t >(boost::thread::hardware_concurrency(), 1);
+}
+
+static void run_strided(boost::function< void(std::size_t) > const &task, std::size_t first,
+                        std::size_t step, std::size_t count)
+{
+  for (std::size_t k = first; k < count; k += step)
+  {
+    task(k);
+  }
+}
+
+void parallel_for(std::size_t threads, std::size_t count,
+                  boost::function< void(std::size_t) > const &task)
+{
+  std::size_t const workers = std::max< std::size_t >(std::min(threads, count), 1);
+  boost::thread_group group;
+  try
+  {
+    for (std::size_t t = 1; t < workers; ++t)
+    {
+      group.create_thread(boost::bind(&run_strided, boost::cref(task), t, workers, count));
+    }
+  }
+  catch (...)
+  {
+    group.join_all();
+    throw;
+  }
+  run_strided(task, 0, workers, count);
+  group.join_all();
+}
+
+input_buffer::input_buffer(char const *data, std::size_t size)
+{
+  char *begin = const_cast< char * >(data);
+  setg(begin, begin, begin + size);
+}
+
+output_buffer::output_buffer(std::string &output) : output(output) {}
+
+output_buffer::int_type output_buffer::overflow(int_type c)
+{
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    output.push_back(traits_type::to_char_type(c));
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize output_buffer::xsputn(char const *data, std::streamsize size)
+{
+  output.append(data, static_cast< std::size_t >(size));
+  return size;
+}
+
+#ifdef AUXILIARY_POSIX
+/// \brief File of file_buffer, written through its descriptor so that it can be synced to disk.
+class file_buffer::device
+{
+public:
+  device(std::string const &filename, bool append)
+      : fd(open(filename.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666))
+  {
+    if (fd < 0)
+    {
+      throw file_access_error();
+    }
+  }
+
+  ~device()
+  {
+    close(fd);
+  }
+
+  bool write(char const *data, std::size_t size)
+  {
+    while (size)
+    {
+      ssize_t const written = ::write(fd, data, size);
+      if (written < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      else if (written <= 0)
+      {
+        return false;
+      }
+      data += written;
+      size -= static_cast< std::size_t >(written);
+    }
+    return true;
+  }
+
+  bool sync()
+  {
+    return fsync(fd) == 0;
+  }
+
+private:
+  int fd;
+};
+#else
+/// \brief File of file_buffer, syncing only flushes it to the operating system.
+class file_buffer::device
+{
+public:
+  device(std::string const &filename, bool append)
+      : file(filename.c_str(),
+             std::ofstream::binary | (append ? std::ofstream::app : std::ofstream::trunc))
+  {
+    if (!file)
+    {
+      throw file_access_error();
+    }
+  }
+
+  bool write(char const *data, std::size_t size)
+  {
+    return static_cast< bool >(file.write(data, static_cast< std::streamsize >(size)));
+  }
+
+  bool sync()
+  {
+    return static_cast< bool >(file.flush());
+  }
+
+private:
+  std::ofstream file;
+};
+#endif
+
+file_buffer::file_buffer(std::string const &filename, bool append)
+    : file(new device(filename, append)), buffer(1 << 16), failed(false)
+{
+  setp(&buffer[0], &buffer[0] + buffer.size());
+}
+
+file_buffer::~file_buffer()
+{
+  drain();
+}
+
+void file_buffer::commit()
+{
+  if (!drain() || !file->sync())
+  {
+    throw file_access_error();
+  }
+}
+
+file_buffer::int_type file_buffer::overflow(int_type c)
+{
+  if (!drain())
+  {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int file_buffer::sync()
+{
+  return drain() ? 0 : -1;
+}
+
+bool file_buffer::drain()
+{
+  std::size_t const size = static_cast< std::size_t >(pptr() - pbase());
+  setp(&buffer[0], &buffer[0] + buffer.size());
+  if (size && !failed)
+  {
+    failed = !file->write(&buffer[0], size);
+  }
+  return !failed;
+}
+
+void replace_file(std::string const &temporary, std::string const &filename)
+{
+  try
+  {
+    boost::filesystem::file_status const status = boost::filesystem::status(filename);
+    if (boost::filesystem::exists(status))
+    {
+      boost::filesystem::permissions(temporary, status.permissions());
+    }
+    boost::filesystem::rename(temporary, filename);
+  }
+  catch (std::exception const &)
+  {
+    throw file_access_error();
+  }
+
+#ifdef AUXILIARY_POSIX
+  // The rename only survives a crash once the directory is synced. Not every file system can sync
+  // directories, the file is in place either way.
+  std::string directory = boost::filesystem::path(filename).parent_path().native();
+  if (directory.empty())
+  {
+    directory = ".";
+  }
+  int const fd = open(directory.c_str(), O_RDONLY);
+  if (fd >= 0)
+  {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+}
 }
@@ -5,9 +5,18 @@
 #ifndef BACKEND_AUXILIARY_HPP_INCLUDED
 #define BACKEND_AUXILIARY_HPP_INCLUDED
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/function.hpp>
 #include <string>
+#include <vector>
+#include <streambuf>
 #include <stdexcept>
 
+namespace aes
+{
+class keystream;
+}
+
 namespace auxiliary
 {
 /// \brief Generate random password.
@@ -21,6 +30,48 @@ namespace auxiliary
 std::string generate_password(std::size_t length, std::string const &special_characters =
                                                       "!@#$%^&*()`~-_=+[{]}\\|;:'\",<.>/?");
 
+/// \brief Generate many random passwords at once.
+///
+/// See password_generator, the alphabet is the same as for generate_password().
+///
+/// \param[in] count Number of passwords to be generated
+/// \param[in] length Length of each password
+/// \param[in] special_characters Additional alphabet of special characters
+/// \return Generated passwords
+std::vector< std::string > generate_passwords(std::size_t count, std::size_t length,
+                                              std::string const &special_characters =
+                                                  "!@#$%^&*()`~-_=+[{]}\\|;:'\",<.>/?");
+
+/// \brief Random password generator for batches of passwords.
+///
+/// Random bytes are taken in bulk from a buffered AES keystream seeded once from the system's
+/// random device, and mapped to characters of the alphabet by rejection sampling so that every
+/// character is equally likely. Characters repeated in the alphabet are used only once. Reuse a
+/// generator for as many passwords as possible.
+class password_generator
+{
+public:
+  /// \brief Generate passwords from A-Z in upper and lower case, 0-9 and `special_characters`.
+  explicit password_generator(std::string const &special_characters =
+                                  "!@#$%^&*()`~-_=+[{]}\\|;:'\",<.>/?");
+  ~password_generator();
+
+  /// \brief Generate a password of given length.
+  std::string operator()(std::size_t length);
+
+private:
+  /// \brief Next random index into `alphabet`.
+  std::size_t next();
+
+  /// \brief Distinct characters, at most 256, so one random byte is drawn per index.
+  std::string alphabet;
+  /// \brief Random values at or above are rejected to avoid a bias towards the first characters.
+  unsigned int limit;
+  boost::scoped_ptr< aes::keystream > random;
+  std::vector< unsigned char > buffer;
+  std::size_t position;
+};
+
 /// \brief Erase file from hard drive and make it difficult to recover.
 ///
 /// Overwrite the file on hard drive with random content for a given number of iterations before
@@ -32,6 +83,16 @@ std::string generate_password(std::size_t length, std::string const &special_cha
 /// \param[in] iterations Number of times to overwrite the content of the file
 void secure_erase(std::string const &filename, std::size_t iterations = 10);
 
+/// \brief Erase file from hard drive with a given sequence of overwrite passes.
+///
+/// Each pass overwrites the whole file in place and is synced to disk before the next one starts.
+/// A pass either repeats its pattern over the file, or writes random data if its pattern is empty.
+/// Random data is taken from an AES keystream, and memory usage does not depend on the file size.
+///
+/// \param[in] filename File to be erased
+/// \param[in] patterns Pattern of each pass, empty for random data
+void secure_erase(std::string const &filename, std::vector< std::string > const &patterns);
+
 /// \brief Map arbitrary data as a temporary file on disk.
 ///
 /// A temporary file will be created to access given content. It is advisable to remove the file
@@ -39,9 +100,110 @@ void secure_erase(std::string const &filename, std::size_t iterations = 10);
 /// directly, making access to it virtually impossible when it's not mapped in the current session,
 /// but there is no guarantee this will happen due to cross platform concerns.
 ///
+/// If `in_memory` is requested and supported by the system (Linux memfd), the file is an anonymous
+/// file that only ever lives in RAM, accessible by its /proc path as long as it is not unmapped. A
+/// temporary file on disk is used otherwise.
+///
 /// \param[in] content Content to be mapped into file
+/// \param[in] in_memory Whether to keep the file in RAM if possible
 /// \return Absolute path to temporary file
-std::string map_file(std::string const &content);
+std::string map_file(std::string const &content, bool in_memory = false);
+
+/// \brief Remove a file created by map_file().
+///
+/// In-memory files are released at once, files on disk are erased by secure_erase().
+///
+/// \param[in] filename Path returned by map_file()
+/// \param[in] iterations Number of times to overwrite the content of a file on disk
+void unmap_file(std::string const &filename, std::size_t iterations = 10);
+
+/// \brief Number of threads to use for parallel work.
+///
+/// \param[in] threads Requested number of threads, 0 for one per hardware thread
+/// \return `threads`, or the number of hardware threads if 0
+std::size_t thread_count(std::size_t threads);
+
+/// \brief Run `task` for all indices below `count` on up to `threads` threads.
+///
+/// Indices are distributed round-robin, the calling thread takes part, so a single thread does not
+/// spawn any. The task must not throw, callers collect errors and throw after all tasks are done.
+///
+/// \param[in] threads Number of threads, see thread_count()
+/// \param[in] count Number of indices
+/// \param[in] task Function called once for each index
+void parallel_for(std::size_t threads, std::size_t count,
+                  boost::function< void(std::size_t) > const &task);
+
+/// \brief Read-only stream buffer over memory owned by someone else.
+///
+/// Allows stream based parsers to consume an in-memory blob without copying it first. The memory
+/// must outlive the buffer.
+class input_buffer : public std::streambuf
+{
+public:
+  /// \brief Read `size` bytes starting at `data`.
+  input_buffer(char const *data, std::size_t size);
+};
+
+/// \brief Write-only stream buffer appending to a string.
+///
+/// Allows stream based serializers to produce a blob in place, without the extra copy of
+/// `std::ostringstream::str()`.
+class output_buffer : public std::streambuf
+{
+public:
+  /// \brief Append everything written to `output`.
+  explicit output_buffer(std::string &output);
+
+protected:
+  int_type overflow(int_type c);
+  std::streamsize xsputn(char const *data, std::streamsize size);
+
+private:
+  std::string &output;
+};
+
+/// \brief Write-only stream buffer over a file, which can be synced to disk.
+///
+/// Writes are buffered in memory. On POSIX systems commit() waits until the data is on disk, on
+/// other systems it only hands the data over to the operating system.
+class file_buffer : public std::streambuf
+{
+public:
+  /// \brief Write to `filename`, appending to it or truncating it. Throws file_access_error.
+  file_buffer(std::string const &filename, bool append);
+  ~file_buffer();
+
+  /// \brief Write buffered data and sync the file to disk.
+  ///
+  /// Throws file_access_error if this or any earlier write failed.
+  void commit();
+
+protected:
+  int_type overflow(int_type c);
+  int sync();
+
+private:
+  class device;
+
+  /// \brief Write buffered data to the file, returns false if any write failed so far.
+  bool drain();
+
+  boost::scoped_ptr< device > file;
+  std::vector< char > buffer;
+  /// \brief Whether a write failed, data written afterwards is dropped.
+  bool failed;
+};
+
+/// \brief Replace `filename` by the file at `temporary` in a single step.
+///
+/// The new file takes over the permissions of the file it replaces. Readers see either the old or
+/// the new file, but never a partially written one, as long as `temporary` was committed by
+/// file_buffer and lives in the same directory.
+///
+/// \param[in] temporary File to be moved
+/// \param[in] filename File to be replaced
+void replace_file(std::string const &temporary, std::string const &filename);
 
 /// \brief Error to be thrown in case of an invalid file access.
 class file_access_error : public std::runtime_error
@@ -3,36 +3,395 @@
 // code package.
 
 #include "base64.hpp"
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/binary_from_base64.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
-#include <boost/archive/iterators/remove_whitespace.hpp>
-#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
 
 namespace base64
 {
-std::string encode(std::string const &input)
+static char const alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// \brief Classes of input characters besides the 64 digits, see digit().
+enum
+{
+  DIGIT_INVALID = 64,
+  DIGIT_SPACE,
+  DIGIT_PAD
+};
+
+/// \brief Value of each input character, or one of the character classes above.
+class digits
+{
+public:
+  digits()
+  {
+    for (std::size_t k = 0; k < sizeof(table); ++k)
+    {
+      table[k] = DIGIT_INVALID;
+    }
+    for (std::size_t k = 0; k < 64; ++k)
+    {
+      table[static_cast< unsigned char >(alphabet[k])] = static_cast< unsigned char >(k);
+    }
+    table[static_cast< unsigned char >(' ')] = DIGIT_SPACE;
+    table[static_cast< unsigned char >('\t')] = DIGIT_SPACE;
+    table[static_cast< unsigned char >('\n')] = DIGIT_SPACE;
+    table[static_cast< unsigned char >('\r')] = DIGIT_SPACE;
+    table[static_cast< unsigned char >('=')] = DIGIT_PAD;
+  }
+
+  unsigned int operator[](char c) const
+  {
+    return table[static_cast< unsigned char >(c)];
+  }
+
+private:
+  unsigned char table[256];
+};
+
+static digits const digit;
+
+/// \brief Scalar encoder, handles the tail left over by the vectorized encoders.
+static std::size_t encode_scalar(unsigned char const *input, std::size_t size, char *output)
+{
+  char *out = output;
+  for (; size >= 3; input += 3, size -= 3)
+  {
+    unsigned long const bits = (static_cast< unsigned long >(input[0]) << 16) |
+                               (static_cast< unsigned long >(input[1]) << 8) | input[2];
+    *out++ = alphabet[(bits >> 18) & 0x3F];
+    *out++ = alphabet[(bits >> 12) & 0x3F];
+    *out++ = alphabet[(bits >> 6) & 0x3F];
+    *out++ = alphabet[bits & 0x3F];
+  }
+  if (size)
+  {
+    unsigned long const bits = (static_cast< unsigned long >(input[0]) << 16) |
+                               (size > 1 ? static_cast< unsigned long >(input[1]) << 8 : 0);
+    *out++ = alphabet[(bits >> 18) & 0x3F];
+    *out++ = alphabet[(bits >> 12) & 0x3F];
+    *out++ = size > 1 ? alphabet[(bits >> 6) & 0x3F] : '=';
+    *out++ = '=';
+  }
+  return out - output;
+}
+
+/// \brief Scalar decoder, handles whitespace, padding and the tail left over by the vectorized
+/// decoders.
+///
+/// Like the original boost::archive based decoder, incomplete trailing bits are dropped.
+static std::size_t decode_scalar(char const *input, std::size_t size, unsigned char *output)
+{
+  char const *const end = input + size;
+  unsigned char *out = output;
+  unsigned long bits = 0;
+  unsigned int count = 0;
+
+  while (input != end)
+  {
+    // Fast path for groups of four digits without whitespace.
+    if (count == 0 && end - input >= 4)
+    {
+      unsigned int const a = digit[input[0]], b = digit[input[1]], c = digit[input[2]],
+                         d = digit[input[3]];
+      if ((a | b | c | d) < 64)
+      {
+        unsigned long const group = (a << 18) | (b << 12) | (c << 6) | d;
+        *out++ = static_cast< unsigned char >(group >> 16);
+        *out++ = static_cast< unsigned char >(group >> 8);
+        *out++ = static_cast< unsigned char >(group);
+        input += 4;
+        continue;
+      }
+    }
+
+    unsigned int const value = digit[*input++];
+    if (value < 64)
+    {
+      bits = (bits << 6) | value;
+      if (++count == 4)
+      {
+        *out++ = static_cast< unsigned char >(bits >> 16);
+        *out++ = static_cast< unsigned char >(bits >> 8);
+        *out++ = static_cast< unsigned char >(bits);
+        bits = 0;
+        count = 0;
+      }
+    }
+    else if (value == DIGIT_PAD)
+    {
+      // Padding may only be followed by more padding or whitespace.
+      for (; input != end; ++input)
+      {
+        if (digit[*input] != DIGIT_PAD && digit[*input] != DIGIT_SPACE)
+        {
+          throw decode_error();
+        }
+      }
+    }
+    else if (value != DIGIT_SPACE)
+    {
+      throw decode_error();
+    }
+  }
+
+  if (count >= 2)
+  {
+    *out++ = static_cast< unsigned char >(bits >> (6 * count - 8));
+  }
+  if (count == 3)
+  {
+    *out++ = static_cast< unsigned char >(bits >> 2);
+  }
+  return out - output;
+}
+
+#ifdef BASE64_X86
+// Vectorized codecs following W. Muła and D. Lemire, "Faster Base64 Encoding and Decoding using
+// AVX2 Instructions". They process whole blocks of the alphabet only, and leave whitespace,
+// padding and the remaining tail to the scalar codecs.
+
+/// \brief Map 6 bit indices to alphabet characters.
+__attribute__((target("ssse3"))) static inline __m128i encode_lookup(__m128i indices)
+{
+  __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i const less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+  __m128i const shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                      '/' - 63, 'A', 0, 0);
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+}
+
+/// \brief Split each 3 byte group of the input into four 6 bit indices.
+__attribute__((target("ssse3"))) static inline __m128i encode_split(__m128i input)
+{
+  input = _mm_shuffle_epi8(input, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m128i const t0 = _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00));
+  __m128i const t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i const t2 = _mm_and_si128(input, _mm_set1_epi32(0x003f03f0));
+  __m128i const t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3"))) static std::size_t encode_ssse3(unsigned char const *input,
+                                                                 std::size_t size, char *output)
+{
+  std::size_t done = 0;
+  for (; done + 16 <= size; done += 12)
+  {
+    __m128i const block =
+        _mm_loadu_si128(reinterpret_cast< __m128i const * >(input + done));
+    _mm_storeu_si128(reinterpret_cast< __m128i * >(output + done / 3 * 4),
+                     encode_lookup(encode_split(block)));
+  }
+  return done;
+}
+
+__attribute__((target("avx2"))) static std::size_t encode_avx2(unsigned char const *input,
+                                                               std::size_t size, char *output)
+{
+  __m256i const shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0,
+                                           2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  __m256i const shift = _mm256_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+      'A', 0, 0);
+
+  std::size_t done = 0;
+  for (; done + 28 <= size; done += 24)
+  {
+    __m128i const low = _mm_loadu_si128(reinterpret_cast< __m128i const * >(input + done));
+    __m128i const high = _mm_loadu_si128(reinterpret_cast< __m128i const * >(input + done + 12));
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+    block = _mm256_shuffle_epi8(block, shuffle);
+    __m256i const t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i const t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i const t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+    __m256i const t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i const indices = _mm256_or_si256(t1, t3);
+
+    __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i const less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+    result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result), indices);
+    _mm256_storeu_si256(reinterpret_cast< __m256i * >(output + done / 3 * 4), result);
+  }
+  return done;
+}
+
+__attribute__((target("ssse3"))) static std::size_t decode_ssse3(char const *input,
+                                                                 std::size_t size,
+                                                                 unsigned char *output)
+{
+  __m128i const lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  __m128i const lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  __m128i const lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i const mask = _mm_set1_epi8(0x2F);
+
+  // Stores write 16 bytes for 12 decoded ones, the margin keeps them within decoded_size().
+  std::size_t done = 0;
+  for (; done + 24 <= size; done += 16)
+  {
+    __m128i const block = _mm_loadu_si128(reinterpret_cast< __m128i const * >(input + done));
+    __m128i const hi_nibbles = _mm_and_si128(_mm_srli_epi32(block, 4), mask);
+    __m128i const lo_nibbles = _mm_and_si128(block, mask);
+    __m128i const lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    __m128i const hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+    {
+      break;
+    }
+
+    __m128i const eq_2f = _mm_cmpeq_epi8(block, mask);
+    __m128i const roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    __m128i const values = _mm_add_epi8(block, roll);
+    __m128i const merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i const packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    __m128i const result = _mm_shuffle_epi8(
+        packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128(reinterpret_cast< __m128i * >(output + done / 4 * 3), result);
+  }
+  return done;
+}
+
+__attribute__((target("avx2"))) static std::size_t decode_avx2(char const *input,
+                                                               std::size_t size,
+                                                               unsigned char *output)
 {
-  namespace iterators = boost::archive::iterators;
-  typedef iterators::base64_from_binary<
-      iterators::transform_width< std::string::const_iterator, 6, 8 > > iterator;
+  __m256i const lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+      0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+      0x1B, 0x1A);
+  __m256i const lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10);
+  __m256i const lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+                                            0, 0);
+  __m256i const mask = _mm256_set1_epi8(0x2F);
+  __m256i const pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2,
+                                        1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+  // Stores write 32 bytes for 24 decoded ones, the margin keeps them within decoded_size().
+  std::size_t done = 0;
+  for (; done + 48 <= size; done += 32)
+  {
+    __m256i const block = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(input + done));
+    __m256i const hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(block, 4), mask);
+    __m256i const lo_nibbles = _mm256_and_si256(block, mask);
+    __m256i const lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+    __m256i const hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+    if (!_mm256_testz_si256(lo, hi))
+    {
+      break;
+    }
 
-  std::string output(iterator(input.begin()), iterator(input.end()));
-  return output.append((3 - input.size() % 3) % 3, '=');
+    __m256i const eq_2f = _mm256_cmpeq_epi8(block, mask);
+    __m256i const roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+    __m256i const values = _mm256_add_epi8(block, roll);
+    __m256i const merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    __m256i const packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    __m256i const result = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(packed, pack),
+                                                       _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+    _mm256_storeu_si256(reinterpret_cast< __m256i * >(output + done / 4 * 3), result);
+  }
+  return done;
 }
 
-std::string decode(std::string input)
+/// \brief Instruction sets usable on the running processor.
+enum
+{
+  LEVEL_SCALAR,
+  LEVEL_SSSE3,
+  LEVEL_AVX2
+};
+
+static int detect_level()
 {
-  namespace iterators = boost::archive::iterators;
-  typedef iterators::transform_width<
-      iterators::binary_from_base64< iterators::remove_whitespace< std::string::const_iterator > >,
-      8, 6 > iterator;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return LEVEL_AVX2;
+  }
+  else if (__builtin_cpu_supports("ssse3"))
+  {
+    return LEVEL_SSSE3;
+  }
+  return LEVEL_SCALAR;
+}
+
+static int const level = detect_level();
+#endif
 
-  std::size_t padding = std::count(input.begin(), input.end(), '=');
-  std::replace(input.begin(), input.end(), '=', 'A');
-  std::string output(iterator(input.begin()), iterator(input.end()));
-  output.erase(output.end() - padding, output.end());
+std::size_t encoded_size(std::size_t size)
+{
+  return (size + 2) / 3 * 4;
+}
 
+std::size_t decoded_size(std::size_t size)
+{
+  return size / 4 * 3 + size % 4 * 3 / 4;
+}
+
+std::size_t encode(char const *input, std::size_t size, char *output)
+{
+  unsigned char const *data = reinterpret_cast< unsigned char const * >(input);
+  std::size_t done = 0;
+#ifdef BASE64_X86
+  if (level >= LEVEL_AVX2)
+  {
+    done = encode_avx2(data, size, output);
+  }
+  if (level >= LEVEL_SSSE3)
+  {
+    done += encode_ssse3(data + done, size - done, output + done / 3 * 4);
+  }
+#endif
+  return done / 3 * 4 + encode_scalar(data + done, size - done, output + done / 3 * 4);
+}
+
+std::size_t decode(char const *input, std::size_t size, char *output)
+{
+  unsigned char *data = reinterpret_cast< unsigned char * >(output);
+  std::size_t done = 0;
+#ifdef BASE64_X86
+  if (level >= LEVEL_AVX2)
+  {
+    done = decode_avx2(input, size, data);
+  }
+  if (level >= LEVEL_SSSE3)
+  {
+    done += decode_ssse3(input + done, size - done, data + done / 4 * 3);
+  }
+#endif
+  return done / 4 * 3 + decode_scalar(input + done, size - done, data + done / 4 * 3);
+}
+
+std::string encode(std::string const &input)
+{
+  std::string output(encoded_size(input.size()), 0x0);
+  if (!input.empty())
+  {
+    encode(input.data(), input.size(), &output[0]);
+  }
+  return output;
+}
+
+std::string decode(std::string const &input)
+{
+  std::string output(decoded_size(input.size()), 0x0);
+  if (!input.empty())
+  {
+    output.resize(decode(input.data(), input.size(), &output[0]));
+  }
   return output;
 }
 }
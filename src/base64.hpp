@@ -6,6 +6,8 @@
 #define BACKEND_BASE64_HPP_INCLUDED
 
 #include <string>
+#include <cstddef>
+#include <stdexcept>
 
 namespace base64
 {
@@ -20,11 +22,45 @@ std::string encode(std::string const &input);
 
 /// \brief Decode base64 to blob.
 ///
-/// Base64 input is decoded to binary format for usage.
+/// Base64 input is decoded to binary format for usage. Whitespace is ignored, padding is optional.
+/// Throws decode_error on malformed input.
 ///
 /// \param[in] input Base64 input to be decoded
 /// \return Decoded data
-std::string decode(std::string input);
+std::string decode(std::string const &input);
+
+/// \brief Size of the base64 encoding of `size` bytes.
+std::size_t encoded_size(std::size_t size);
+
+/// \brief Upper bound for the decoded size of `size` base64 characters.
+std::size_t decoded_size(std::size_t size);
+
+/// \brief Encode blob to base64 into a caller provided buffer.
+///
+/// \param[in] input Beginning of blob
+/// \param[in] size Size of blob
+/// \param[out] output Buffer of at least encoded_size(size) characters
+/// \return Number of characters written
+std::size_t encode(char const *input, std::size_t size, char *output);
+
+/// \brief Decode base64 to blob into a caller provided buffer.
+///
+/// Decoding in place is supported by passing `input` as `output`. Throws decode_error on malformed
+/// input.
+///
+/// \param[in] input Beginning of base64 input
+/// \param[in] size Size of base64 input
+/// \param[out] output Buffer of at least decoded_size(size) bytes
+/// \return Number of bytes written
+std::size_t decode(char const *input, std::size_t size, char *output);
+
+/// \brief Error to be thrown if the input is not valid base64.
+class decode_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  decode_error() : std::runtime_error("malformed base64") {}
+};
 }
 
 #endif // BACKEND_BASE64_HPP_INCLUDED
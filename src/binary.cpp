@@ -0,0 +1,122 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "binary.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace binary
+{
+static char const magic[] = {'\x89', 'W', 'A', 'L', 'L', 'E', 'Y', '\n'};
+
+bool detect(std::streambuf &input)
+{
+  return input.sgetc() == static_cast< unsigned char >(magic[0]);
+}
+
+writer::writer(std::ostream &output) : output(output) {}
+
+void writer::header()
+{
+  output.write(magic, sizeof(magic));
+  number(version);
+}
+
+void writer::number(boost::uint64_t value)
+{
+  char buffer[10];
+  std::size_t size = 0;
+  while (value >= 0x80)
+  {
+    buffer[size++] = static_cast< char >((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = static_cast< char >(value);
+  output.write(buffer, size);
+}
+
+void writer::value(char const *data, std::size_t size)
+{
+  number(size);
+  output.write(data, size);
+}
+
+void writer::value(std::string const &value)
+{
+  this->value(value.data(), value.size());
+}
+
+void writer::raw(std::string const &data)
+{
+  output.write(data.data(), data.size());
+}
+
+reader::reader(std::streambuf &input) : input(input) {}
+
+boost::uint64_t reader::header()
+{
+  char buffer[sizeof(magic)];
+  if (input.sgetn(buffer, sizeof(buffer)) != sizeof(buffer) ||
+      std::memcmp(buffer, magic, sizeof(magic)) != 0)
+  {
+    throw format_error();
+  }
+  return number();
+}
+
+boost::uint64_t reader::number()
+{
+  boost::uint64_t output = 0;
+  for (unsigned int shift = 0; shift < 64; shift += 7)
+  {
+    int const c = input.sbumpc();
+    if (c == std::streambuf::traits_type::eof())
+    {
+      throw format_error();
+    }
+    output |= static_cast< boost::uint64_t >(c & 0x7F) << shift;
+    if (!(c & 0x80))
+    {
+      return output;
+    }
+  }
+  throw format_error();
+}
+
+void reader::value(std::string &output)
+{
+  // Grow the output while reading, so a corrupted length cannot trigger a huge allocation before
+  // the input runs dry.
+  std::size_t const chunk_size = 1 << 20;
+
+  boost::uint64_t remaining = number();
+  output.clear();
+  while (remaining)
+  {
+    std::size_t const offset = output.size();
+    std::size_t const size = static_cast< std::size_t >(
+        std::min< boost::uint64_t >(remaining, std::max(offset, chunk_size)));
+    output.resize(offset + size);
+    if (input.sgetn(&output[offset], size) != static_cast< std::streamsize >(size))
+    {
+      throw format_error();
+    }
+    remaining -= size;
+  }
+}
+
+void reader::skip()
+{
+  std::string ignored;
+  value(ignored);
+}
+
+void reader::finish()
+{
+  if (input.sgetc() != std::streambuf::traits_type::eof())
+  {
+    throw format_error();
+  }
+}
+}
@@ -0,0 +1,87 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_BINARY_HPP_INCLUDED
+#define BACKEND_BINARY_HPP_INCLUDED
+
+#include <boost/cstdint.hpp>
+#include <string>
+#include <ostream>
+#include <streambuf>
+#include <stdexcept>
+
+namespace binary
+{
+/// \brief Current version of the binary format, written after the magic bytes.
+boost::uint64_t const version = 1;
+
+/// \brief Check whether the input is in binary format without consuming it.
+///
+/// Only the first magic byte is inspected, which can never start a JSON document. The remaining
+/// magic bytes are verified by reader::header().
+///
+/// \param[in] input Input to be checked
+/// \return Whether the input is in binary format
+bool detect(std::streambuf &input);
+
+/// \brief Streaming writer for length-prefixed binary records.
+///
+/// Numbers are written as unsigned LEB128, values as their length followed by their raw bytes.
+/// Fields of records are always written as values, anything else is encoded into one first, so
+/// fields appended by newer versions can be skipped by older readers, see reader::skip().
+class writer
+{
+public:
+  /// \brief Write to the given stream.
+  explicit writer(std::ostream &output);
+
+  /// \brief Write magic bytes and format version.
+  void header();
+  /// \brief Write an unsigned number.
+  void number(boost::uint64_t value);
+  /// \brief Write a length-prefixed value.
+  void value(char const *data, std::size_t size);
+  /// \brief Write a length-prefixed value.
+  void value(std::string const &value);
+  /// \brief Write numbers and values serialized by another writer as they are.
+  void raw(std::string const &data);
+
+private:
+  std::ostream &output;
+};
+
+/// \brief Streaming reader for length-prefixed binary records.
+///
+/// Throws format_error on truncated or malformed input.
+class reader
+{
+public:
+  /// \brief Read from the given stream buffer.
+  explicit reader(std::streambuf &input);
+
+  /// \brief Read magic bytes and return the format version.
+  boost::uint64_t header();
+  /// \brief Read an unsigned number.
+  boost::uint64_t number();
+  /// \brief Read a length-prefixed value into `output`.
+  void value(std::string &output);
+  /// \brief Skip a length-prefixed value.
+  void skip();
+  /// \brief Assert that the input is exhausted.
+  void finish();
+
+private:
+  std::streambuf &input;
+};
+
+/// \brief Error to be thrown if the input is not in valid binary format.
+class format_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  format_error() : std::runtime_error("malformed binary record") {}
+};
+}
+
+#endif // BACKEND_BINARY_HPP_INCLUDED
@@ -0,0 +1,109 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "csv.hpp"
+
+namespace csv
+{
+writer::writer(std::ostream &output) : output(output), first(true) {}
+
+void writer::field(std::string const &value)
+{
+  if (!first)
+  {
+    output.put(',');
+  }
+  first = false;
+
+  if (value.find_first_of(",\"\r\n") == std::string::npos)
+  {
+    output.write(value.data(), value.size());
+    return;
+  }
+
+  output.put('"');
+  std::size_t run = 0;
+  for (std::size_t quote = value.find('"'); quote != std::string::npos;
+       quote = value.find('"', run))
+  {
+    output.write(value.data() + run, quote + 1 - run);
+    output.put('"');
+    run = quote + 1;
+  }
+  output.write(value.data() + run, value.size() - run);
+  output.put('"');
+}
+
+void writer::end_row()
+{
+  output.write("\r\n", 2);
+  first = true;
+}
+
+reader::reader(std::streambuf &input) : input(input) {}
+
+bool reader::row(std::vector< std::string > &fields)
+{
+  typedef std::streambuf::traits_type traits;
+
+  int c = input.sbumpc();
+  if (c == traits::eof())
+  {
+    return false;
+  }
+
+  std::size_t count = 0;
+  for (;;)
+  {
+    if (fields.size() == count)
+    {
+      fields.push_back(std::string());
+    }
+    std::string &value = fields[count++];
+    value.clear();
+
+    if (c == '"')
+    {
+      for (c = input.sbumpc();; c = input.sbumpc())
+      {
+        if (c == traits::eof())
+        {
+          throw parse_error();
+        }
+        else if (c == '"')
+        {
+          c = input.sbumpc();
+          if (c != '"')
+          {
+            break;
+          }
+        }
+        value.push_back(static_cast< char >(c));
+      }
+    }
+    else
+    {
+      for (; c != ',' && c != '\r' && c != '\n' && c != traits::eof(); c = input.sbumpc())
+      {
+        value.push_back(static_cast< char >(c));
+      }
+    }
+
+    if (c == '\r')
+    {
+      c = input.sbumpc();
+    }
+    if (c == '\n' || c == traits::eof())
+    {
+      fields.resize(count);
+      return true;
+    }
+    else if (c != ',')
+    {
+      throw parse_error();
+    }
+    c = input.sbumpc();
+  }
+}
+}
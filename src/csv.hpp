@@ -0,0 +1,66 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_CSV_HPP_INCLUDED
+#define BACKEND_CSV_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <streambuf>
+#include <stdexcept>
+
+/// \brief Comma separated values as described by RFC 4180.
+namespace csv
+{
+/// \brief Streaming writer for CSV rows.
+///
+/// Fields containing commas, quotes or line breaks are quoted, quotes within are doubled. Rows end
+/// with CRLF.
+class writer
+{
+public:
+  /// \brief Write to the given stream.
+  explicit writer(std::ostream &output);
+
+  /// \brief Write a field of the current row.
+  void field(std::string const &value);
+  /// \brief End the current row.
+  void end_row();
+
+private:
+  std::ostream &output;
+  bool first;
+};
+
+/// \brief Streaming reader for CSV rows.
+///
+/// Rows are pulled from the given stream buffer one at a time, so memory use only depends on the
+/// size of a row. Rows may end with CRLF or LF alone. Throws parse_error on malformed input.
+class reader
+{
+public:
+  /// \brief Read from the given stream buffer.
+  explicit reader(std::streambuf &input);
+
+  /// \brief Read the next row into `fields`.
+  ///
+  /// \param[out] fields Fields of the row, reusing the capacity of its strings
+  /// \return Whether there was another row
+  bool row(std::vector< std::string > &fields);
+
+private:
+  std::streambuf &input;
+};
+
+/// \brief Error to be thrown if the input is not valid CSV.
+class parse_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  parse_error() : std::runtime_error("malformed csv") {}
+};
+}
+
+#endif // BACKEND_CSV_HPP_INCLUDED
@@ -0,0 +1,153 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "envelope.hpp"
+#include "aes.hpp"
+#include <boost/random/random_device.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace envelope
+{
+static char const magic[] = {'\x89', 'W', 'A', 'L', 'L', 'E', 'Y', 'K'};
+
+/// \brief Offsets of the fields of a header.
+enum
+{
+  OFFSET_VERSION = sizeof(magic),
+  OFFSET_LAYOUT,
+  OFFSET_PARAMETERS
+};
+
+/// \brief Size of the key derivation parameters, salt and iterations.
+static std::size_t const parameters_size = salt_size + 4;
+
+/// \brief Whether a work factor is within the bounds accepted for stores.
+static bool valid_iterations(boost::uint32_t iterations)
+{
+  return iterations > 0 && iterations <= aes::max_iterations;
+}
+
+/// \brief Size of the fields authenticated along with the wrapped data key.
+static std::size_t const associated_size = OFFSET_PARAMETERS + parameters_size;
+
+/// \brief Size of initialization vector and wrapped data key with its tag.
+static std::size_t const wrapped_size = aes::block_size + key_size + aes::tag_size;
+
+static std::string random_bytes(std::size_t size)
+{
+  boost::random::random_device rng;
+  std::string output(size, 0x0);
+  for (std::size_t k = 0; k < size; k += 4)
+  {
+    unsigned int const bits = rng();
+    std::memcpy(&output[k], &bits, std::min< std::size_t >(4, size - k));
+  }
+  return output;
+}
+
+bool detect(char const *data, std::size_t size)
+{
+  return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+std::size_t header_size(char const *data, std::size_t size)
+{
+  if (!detect(data, size) || size < max_header_size ||
+      static_cast< unsigned char >(data[OFFSET_VERSION]) != version ||
+      static_cast< unsigned char >(data[OFFSET_LAYOUT]) > LAYOUT_CHUNKED)
+  {
+    throw format_error();
+  }
+  return max_header_size;
+}
+
+parameters read_parameters(char const *data, std::size_t size)
+{
+  header_size(data, size);
+
+  parameters output;
+  char const *iterations = data + OFFSET_PARAMETERS + salt_size;
+  output.salt.assign(data + OFFSET_PARAMETERS, salt_size);
+  for (std::size_t k = 0; k < 4; ++k)
+  {
+    output.iterations |= static_cast< boost::uint32_t >(static_cast< unsigned char >(iterations[k]))
+                         << (8 * k);
+  }
+
+  // Checked before any key is derived, so a corrupt header can neither hang nor trivialize it.
+  if (!valid_iterations(output.iterations))
+  {
+    throw format_error();
+  }
+  return output;
+}
+
+parameters generate_parameters(boost::uint32_t iterations)
+{
+  if (!valid_iterations(iterations))
+  {
+    throw format_error();
+  }
+
+  parameters output;
+  output.salt = random_bytes(salt_size);
+  output.iterations = iterations;
+  return output;
+}
+
+std::string wrapping_key(std::string const &password, parameters const &kdf)
+{
+  return aes::derive_key(password, kdf.salt, kdf.iterations);
+}
+
+std::string generate_key()
+{
+  return random_bytes(key_size);
+}
+
+std::string seal(std::string const &wrapping, parameters const &kdf, layout_type layout,
+                 std::string const &key)
+{
+  if (kdf.salt.size() != salt_size || !valid_iterations(kdf.iterations))
+  {
+    throw format_error();
+  }
+
+  std::string output(magic, sizeof(magic));
+  output += static_cast< char >(version);
+  output += static_cast< char >(layout);
+  output += kdf.salt;
+  for (std::size_t k = 0; k < 4; ++k)
+  {
+    output += static_cast< char >((kdf.iterations >> (8 * k)) & 0xFF);
+  }
+
+  // The fields in front of the data key are authenticated with it, so none can be altered.
+  std::string const iv = random_bytes(aes::block_size);
+  std::string const wrapped = aes::seal(wrapping, iv, key, output);
+  output += iv;
+  output += wrapped;
+  return output;
+}
+
+std::string open(std::string const &wrapping, char const *data, std::size_t size,
+                 layout_type &layout)
+{
+  char const *iv = data + header_size(data, size) - wrapped_size;
+  std::string key;
+  try
+  {
+    key = aes::open(wrapping, std::string(iv, aes::block_size), iv + aes::block_size,
+                    key_size + aes::tag_size, std::string(data, associated_size));
+  }
+  catch (aes::integrity_error const &)
+  {
+    throw format_error();
+  }
+
+  layout = static_cast< layout_type >(data[OFFSET_LAYOUT]);
+  return key;
+}
+}
@@ -0,0 +1,113 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_ENVELOPE_HPP_INCLUDED
+#define BACKEND_ENVELOPE_HPP_INCLUDED
+
+#include <boost/cstdint.hpp>
+#include <string>
+#include <stdexcept>
+
+/// \brief Envelope encryption of stores.
+///
+/// The payload of a store is encrypted with a random data key, which is stored in a fixed-size
+/// header wrapped by the key derived from the master password. Changing the master password thus
+/// only rewrites the header, independent of the size of the store. The header consists of magic
+/// bytes, version and payload layout, followed by the key derivation parameters, a random
+/// initialization vector and the data key wrapped with AES-GCM. Its tag covers all fields in front
+/// of it as well, telling a wrong password from a valid one and detecting any altered field.
+namespace envelope
+{
+/// \brief Current version of the header, written after the magic bytes.
+unsigned char const version = 2;
+
+/// \brief Size of data keys.
+std::size_t const key_size = 32;
+
+/// \brief Size of key derivation salts.
+std::size_t const salt_size = 16;
+
+/// \brief Size of headers.
+std::size_t const max_header_size = 94;
+
+/// \brief Parameters deriving the key that wraps the data key from a master password.
+struct parameters
+{
+  parameters() : iterations(0) {}
+
+  /// \brief Random salt of salt_size bytes.
+  std::string salt;
+  /// \brief Work factor, see aes::derive_key().
+  boost::uint32_t iterations;
+};
+
+/// \brief Layouts of the payload following the header.
+enum layout_type
+{
+  /// \brief A single ciphertext of the serialized store, see aes::encryptor.
+  LAYOUT_STREAM,
+  /// \brief Individually encrypted elements, see segments.
+  LAYOUT_SEGMENTED,
+  /// \brief Authenticated chunks of the serialized store, see aes::chunked_encryptor.
+  LAYOUT_CHUNKED
+};
+
+/// \brief Check whether a blob starts with an envelope header.
+///
+/// \param[in] data Beginning of blob
+/// \param[in] size Size of blob
+/// \return Whether the blob starts with the magic bytes of a header
+bool detect(char const *data, std::size_t size);
+
+/// \brief Size of the header at the beginning of a blob, throws format_error if malformed.
+std::size_t header_size(char const *data, std::size_t size);
+
+/// \brief Key derivation parameters of the header at the beginning of a blob.
+///
+/// Throws format_error if the work factor is 0 or above aes::max_iterations.
+parameters read_parameters(char const *data, std::size_t size);
+
+/// \brief Fresh parameters with a random salt, throws format_error for work factors out of bounds.
+parameters generate_parameters(boost::uint32_t iterations);
+
+/// \brief Derive the key wrapping the data key from a master password.
+std::string wrapping_key(std::string const &password, parameters const &kdf);
+
+/// \brief Generate a random data key.
+std::string generate_key();
+
+/// \brief Wrap a data key into a header of the current version.
+///
+/// Throws format_error if the parameters could not be read back by read_parameters().
+///
+/// \param[in] wrapping Key the data key is wrapped with, see wrapping_key()
+/// \param[in] kdf Parameters `wrapping` was derived with
+/// \param[in] layout Layout of the payload
+/// \param[in] key Data key the payload is encrypted with
+/// \return Header
+std::string seal(std::string const &wrapping, parameters const &kdf, layout_type layout,
+                 std::string const &key);
+
+/// \brief Unwrap the data key from a header.
+///
+/// Throws format_error on a malformed or altered header or a wrong key.
+///
+/// \param[in] wrapping Key the data key is wrapped with, see wrapping_key()
+/// \param[in] data Beginning of header
+/// \param[in] size Size of blob starting with the header
+/// \param[out] layout Layout of the payload
+/// \return Data key the payload is encrypted with
+std::string open(std::string const &wrapping, char const *data, std::size_t size,
+                 layout_type &layout);
+
+/// \brief Error to be thrown if a header is malformed or the password is wrong.
+class format_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  format_error() : std::runtime_error("malformed envelope") {}
+};
+}
+
+#endif // BACKEND_ENVELOPE_HPP_INCLUDED
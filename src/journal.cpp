@@ -0,0 +1,274 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "journal.hpp"
+#include "aes.hpp"
+#include "schema.hpp"
+#include "serialization.hpp"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+
+namespace journal
+{
+static char const magic[] = {'\x89', 'W', 'A', 'L', 'L', 'E', 'Y', 'J'};
+
+/// \brief Size of the header, magic bytes followed by an initialization vector and the tag over
+/// the magic bytes.
+static std::size_t const header_size = sizeof(magic) + aes::block_size + aes::tag_size;
+
+/// \brief Size of the prefix holding the size of a record.
+static std::size_t const prefix_size = 8;
+
+/// \brief Size of the random part of the initialization vector of a record, stored in front of it.
+static std::size_t const salt_size = 8;
+
+/// \brief Size of the smallest valid record, which is never empty.
+static std::size_t const min_record_size = salt_size + aes::tag_size + 1;
+
+static void put_uint64(char *output, boost::uint64_t value)
+{
+  for (std::size_t k = 0; k < 8; ++k)
+  {
+    output[k] = static_cast< char >((value >> (8 * k)) & 0xFF);
+  }
+}
+
+static boost::uint64_t get_uint64(char const *input)
+{
+  boost::uint64_t output = 0;
+  for (std::size_t k = 0; k < 8; ++k)
+  {
+    output |= static_cast< boost::uint64_t >(static_cast< unsigned char >(input[k])) << (8 * k);
+  }
+  return output;
+}
+
+static std::string read_file(std::string const &filename)
+{
+  std::ifstream file(filename.c_str(), std::ifstream::binary);
+  return std::string(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+}
+
+static std::string random_bytes(boost::random::random_device &rng, std::size_t size)
+{
+  std::string output(size, 0x0);
+  for (std::size_t k = 0; k < size; k += 4)
+  {
+    unsigned int const bits = rng();
+    std::memcpy(&output[k], &bits, std::min< std::size_t >(4, size - k));
+  }
+  return output;
+}
+
+/// \brief Initialization vector of the record at position `index`, given its random part.
+///
+/// The position keeps records from being reordered, the random part keeps a record rewritten after
+/// a torn append from reusing the vector. Its size sets it apart from the nonces of the payload.
+static std::string record_iv(boost::uint64_t index, char const *salt)
+{
+  std::string output(aes::block_size, 0x0);
+  put_uint64(&output[0], index);
+  std::memcpy(&output[8], salt, salt_size);
+  return output;
+}
+
+/// \brief Size of the journal up to its last complete record, 0 if it is stale or malformed.
+///
+/// A record running past the end of the journal, or the last record failing to decrypt, is torn by
+/// an interrupted append and dropped. Any other damaged record throws aes::integrity_error.
+///
+/// \param[in] key Data key of the store
+/// \param[in] data Journal
+/// \param[out] count Number of complete records
+/// \param[out] records Decrypted records if not null
+/// \return Size of the journal up to its last complete record
+static std::size_t valid_size(std::string const &key, std::string const &data,
+                              boost::uint64_t &count, std::vector< std::string > *records)
+{
+  count = 0;
+  if (data.size() < header_size || std::memcmp(data.data(), magic, sizeof(magic)) != 0)
+  {
+    return 0;
+  }
+
+  try
+  {
+    char const *iv = data.data() + sizeof(magic);
+    aes::open(key, std::string(iv, aes::block_size), iv + aes::block_size, aes::tag_size,
+              std::string(magic, sizeof(magic)));
+  }
+  catch (aes::integrity_error const &)
+  {
+    return 0;
+  }
+
+  std::size_t output = header_size;
+  while (data.size() - output >= prefix_size)
+  {
+    std::size_t const available = data.size() - output - prefix_size;
+    boost::uint64_t const size = get_uint64(data.data() + output);
+    if (size < min_record_size)
+    {
+      // File systems may extend a file before its data is written, leaving zeros behind.
+      if (data.find_first_not_of('\0', output) != std::string::npos)
+      {
+        throw aes::integrity_error();
+      }
+      break;
+    }
+    else if (size > available)
+    {
+      break;
+    }
+
+    char const *salt = data.data() + output + prefix_size;
+    std::string record;
+    try
+    {
+      record = aes::open(key, record_iv(count, salt), salt + salt_size,
+                         static_cast< std::size_t >(size) - salt_size);
+    }
+    catch (aes::integrity_error const &)
+    {
+      if (size != available)
+      {
+        throw;
+      }
+      break;
+    }
+
+    if (records)
+    {
+      records->push_back(std::string());
+      records->back().swap(record);
+    }
+    output += prefix_size + static_cast< std::size_t >(size);
+    ++count;
+  }
+  return output;
+}
+
+std::string path(std::string const &filename)
+{
+  return filename + ".journal";
+}
+
+writer::writer(std::string const &key, std::string const &filename)
+    : key(key), position(0), count(0)
+{
+  std::string const existing = read_file(filename);
+  position = valid_size(key, existing, count, 0);
+  try
+  {
+    if (position && position != existing.size())
+    {
+      boost::filesystem::resize_file(filename, position);
+    }
+  }
+  catch (std::exception const &)
+  {
+    throw auxiliary::file_access_error();
+  }
+
+  if (position)
+  {
+    output.reset(new auxiliary::file_buffer(filename, true));
+  }
+  else
+  {
+    std::string const iv = random_bytes(rng, aes::block_size);
+    std::string const tag = aes::seal(key, iv, std::string(), std::string(magic, sizeof(magic)));
+
+    output.reset(new auxiliary::file_buffer(filename, false));
+    output->sputn(magic, sizeof(magic));
+    output->sputn(iv.data(), iv.size());
+    output->sputn(tag.data(), tag.size());
+    output->commit();
+    position = header_size;
+  }
+}
+
+template < typename T >
+void writer::append(unsigned int type, T const &value)
+{
+  std::string plaintext;
+  {
+    auxiliary::output_buffer buffer(plaintext);
+    std::ostream stream(&buffer);
+    binary::writer record(stream);
+    record.number(type);
+    record.number(schema::fields< T >::count);
+    serialization::write(record, value);
+  }
+  write(plaintext);
+}
+
+boost::uint64_t writer::size() const
+{
+  return position;
+}
+
+void writer::write(std::string const &plaintext)
+{
+  std::string const salt = random_bytes(rng, salt_size);
+  std::string const ciphertext = aes::seal(key, record_iv(count, salt.data()), plaintext);
+
+  char prefix[prefix_size];
+  put_uint64(prefix, salt.size() + ciphertext.size());
+  output->sputn(prefix, prefix_size);
+  output->sputn(salt.data(), salt.size());
+  output->sputn(ciphertext.data(), ciphertext.size());
+  output->commit();
+  position += prefix_size + salt.size() + ciphertext.size();
+  ++count;
+}
+
+reader::reader(std::string const &key, std::string const &filename) : position(0), record_type(0)
+{
+  boost::uint64_t count = 0;
+  valid_size(key, read_file(filename), count, &records);
+}
+
+bool reader::next()
+{
+  if (position >= records.size())
+  {
+    return false;
+  }
+
+  std::string const &record = records[position++];
+  record_reader.reset();
+  record_buffer.reset(new auxiliary::input_buffer(record.data(), record.size()));
+  record_reader.reset(new binary::reader(*record_buffer));
+  record_type = static_cast< unsigned int >(record_reader->number());
+  return true;
+}
+
+unsigned int reader::type() const
+{
+  return record_type;
+}
+
+template < typename T >
+void reader::element(T &value)
+{
+  std::size_t const fields = static_cast< std::size_t >(record_reader->number());
+  serialization::read(*record_reader, value, fields);
+  record_reader->finish();
+}
+
+#define JOURNAL_INSTANTIATE(T)                                                                    \
+  template void writer::append< T >(unsigned int, T const &);                                     \
+  template void reader::element< T >(T &);
+
+JOURNAL_INSTANTIATE(walley::login_type)
+JOURNAL_INSTANTIATE(walley::note_type)
+JOURNAL_INSTANTIATE(walley::file_type)
+JOURNAL_INSTANTIATE(walley::contact_type)
+
+#undef JOURNAL_INSTANTIATE
+}
@@ -0,0 +1,89 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_JOURNAL_HPP_INCLUDED
+#define BACKEND_JOURNAL_HPP_INCLUDED
+
+#include "auxiliary.hpp"
+#include "binary.hpp"
+#include <boost/random/random_device.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+/// \brief Append-only journal of changes to a store file.
+///
+/// A journal lives next to its store file and holds the elements set since the store was saved, so
+/// a single change costs one small append instead of rewriting the store. It starts with magic
+/// bytes authenticated with the data key of the store, which ties the journal to the save that
+/// produced this key. A journal left behind by another save is stale and has no records, while
+/// changing the master password keeps the data key and thus the journal. Each record holds the
+/// content type and the serialized element, is encrypted with AES-GCM under its position in the
+/// journal, and is prefixed by its size. A record torn by an interrupted append at the end of the
+/// journal is dropped, while any other damaged record throws aes::integrity_error.
+namespace journal
+{
+/// \brief Path of the journal of a store file.
+std::string path(std::string const &filename);
+
+/// \brief Appending writer for journals.
+class writer
+{
+public:
+  /// \brief Append to the journal at `filename` of the store with the given data key.
+  ///
+  /// A stale journal is replaced by an empty one, a torn record at its end is cut off. Throws
+  /// auxiliary::file_access_error if the journal cannot be written, aes::integrity_error if it is
+  /// damaged.
+  writer(std::string const &key, std::string const &filename);
+
+  /// \brief Append a record of an element of the given content type and sync it to disk.
+  template < typename T >
+  void append(unsigned int type, T const &value);
+
+  /// \brief Size of the journal in bytes.
+  boost::uint64_t size() const;
+
+private:
+  void write(std::string const &plaintext);
+
+  std::string const key;
+  boost::scoped_ptr< auxiliary::file_buffer > output;
+  boost::uint64_t position;
+  /// \brief Number of records, the position of the next one.
+  boost::uint64_t count;
+  boost::random::random_device rng;
+};
+
+/// \brief Reader for the records of a journal.
+///
+/// The journal is read and decrypted as a whole on construction, which is bounded by compaction. A
+/// missing or stale journal has no records. Throws aes::integrity_error on damaged records.
+class reader
+{
+public:
+  /// \brief Read the journal at `filename` of the store with the given data key.
+  reader(std::string const &key, std::string const &filename);
+
+  /// \brief Decrypt the next record, returns false if there is none.
+  bool next();
+
+  /// \brief Content type of the current record.
+  unsigned int type() const;
+
+  /// \brief Deserialize the element of the current record.
+  template < typename T >
+  void element(T &value);
+
+private:
+  std::vector< std::string > records;
+  std::size_t position;
+  boost::scoped_ptr< auxiliary::input_buffer > record_buffer;
+  boost::scoped_ptr< binary::reader > record_reader;
+  unsigned int record_type;
+};
+}
+
+#endif // BACKEND_JOURNAL_HPP_INCLUDED
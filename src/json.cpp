@@ -0,0 +1,385 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "json.hpp"
+#include <cstring>
+
+namespace json
+{
+writer::writer(std::ostream &output) : output(output), base(0), indent(true) {}
+
+writer::writer(std::ostream &output, layout_type layout)
+    : output(output), base(0), indent(layout == LAYOUT_INDENTED)
+{
+}
+
+writer::writer(std::ostream &output, std::size_t depth)
+    : output(output), first(depth, false), base(depth), indent(true)
+{
+}
+
+void writer::begin_object()
+{
+  if (first.size() > base)
+  {
+    separate();
+  }
+  output.put('{');
+  first.push_back(true);
+}
+
+void writer::begin_array(char const *key)
+{
+  separate();
+  output.put('"');
+  output << key;
+  output.write("\": [", 4);
+  first.push_back(true);
+}
+
+void writer::end_object()
+{
+  close('}');
+  if (first.empty())
+  {
+    output.put('\n');
+    // Lines come many to a stream, flushing each of them would dominate writing.
+    if (indent)
+    {
+      output.flush();
+    }
+  }
+}
+
+void writer::end_array()
+{
+  close(']');
+}
+
+void writer::value(char const *key, std::string const &value)
+{
+  separate();
+  output.put('"');
+  output << key;
+  output.write("\": ", 3);
+  quoted(value);
+}
+
+void writer::element(std::string const &text)
+{
+  separate();
+  output.write(text.data(), text.size());
+}
+
+std::size_t writer::depth() const
+{
+  return first.size();
+}
+
+void writer::separate()
+{
+  if (!first.back())
+  {
+    output.put(',');
+  }
+  first.back() = false;
+  if (indent)
+  {
+    output.put('\n');
+    for (std::size_t k = 0; k < first.size(); ++k)
+    {
+      output.write("    ", 4);
+    }
+  }
+}
+
+void writer::close(char c)
+{
+  first.pop_back();
+  if (indent)
+  {
+    output.put('\n');
+    for (std::size_t k = 0; k < first.size(); ++k)
+    {
+      output.write("    ", 4);
+    }
+  }
+  output.put(c);
+}
+
+void writer::quoted(std::string const &value)
+{
+  static char const hexdigits[] = "0123456789ABCDEF";
+
+  output.put('"');
+  char const *run = value.data();
+  char const *const end = value.data() + value.size();
+  for (char const *it = run; it != end; ++it)
+  {
+    unsigned char const c = static_cast< unsigned char >(*it);
+    if (c >= 0x20 && c != '"' && c != '/' && c != '\\')
+    {
+      continue;
+    }
+
+    output.write(run, it - run);
+    run = it + 1;
+    switch (c)
+    {
+    case '\b':
+      output.write("\\b", 2);
+      break;
+    case '\f':
+      output.write("\\f", 2);
+      break;
+    case '\n':
+      output.write("\\n", 2);
+      break;
+    case '\r':
+      output.write("\\r", 2);
+      break;
+    case '\t':
+      output.write("\\t", 2);
+      break;
+    case '/':
+      output.write("\\/", 2);
+      break;
+    case '"':
+      output.write("\\\"", 2);
+      break;
+    case '\\':
+      output.write("\\\\", 2);
+      break;
+    default:
+      char const escaped[] = {'\\', 'u', '0', '0', hexdigits[c >> 4], hexdigits[c & 0xF]};
+      output.write(escaped, sizeof(escaped));
+      break;
+    }
+  }
+  output.write(run, end - run);
+  output.put('"');
+}
+
+reader::reader(std::streambuf &input) : input(input) {}
+
+bool reader::next(char c)
+{
+  if (peek() == static_cast< unsigned char >(c))
+  {
+    input.sbumpc();
+    return true;
+  }
+  return false;
+}
+
+void reader::expect(char c)
+{
+  if (!next(c))
+  {
+    throw parse_error();
+  }
+}
+
+void reader::string(std::string &output)
+{
+  expect('"');
+  output.clear();
+  for (;;)
+  {
+    int const c = input.sbumpc();
+    if (c == '"')
+    {
+      return;
+    }
+    else if (c == '\\')
+    {
+      escape(output);
+    }
+    else if (c == std::streambuf::traits_type::eof() || c < 0x20)
+    {
+      throw parse_error();
+    }
+    else
+    {
+      output.push_back(static_cast< char >(c));
+    }
+  }
+}
+
+void reader::scalar(std::string &output)
+{
+  if (peek() == '"')
+  {
+    string(output);
+    return;
+  }
+
+  output.clear();
+  for (int c = input.sgetc(); c != std::streambuf::traits_type::eof(); c = input.snextc())
+  {
+    if (c == 0 || !std::strchr("0123456789+-.eEtruefalsn", c))
+    {
+      break;
+    }
+    output.push_back(static_cast< char >(c));
+  }
+  if (output.empty())
+  {
+    throw parse_error();
+  }
+}
+
+void reader::skip()
+{
+  std::string ignored;
+  if (next('{'))
+  {
+    if (!next('}'))
+    {
+      do
+      {
+        string(ignored);
+        expect(':');
+        skip();
+      } while (next(','));
+      expect('}');
+    }
+  }
+  else if (next('['))
+  {
+    if (!next(']'))
+    {
+      do
+      {
+        skip();
+      } while (next(','));
+      expect(']');
+    }
+  }
+  else
+  {
+    scalar(ignored);
+  }
+}
+
+bool reader::done()
+{
+  return peek() == std::streambuf::traits_type::eof();
+}
+
+void reader::finish()
+{
+  if (!done())
+  {
+    throw parse_error();
+  }
+}
+
+int reader::peek()
+{
+  int c = input.sgetc();
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+  {
+    c = input.snextc();
+  }
+  return c;
+}
+
+static unsigned long read_hex(std::streambuf &input)
+{
+  unsigned long output = 0;
+  for (int k = 0; k < 4; ++k)
+  {
+    int const c = input.sbumpc();
+    output <<= 4;
+    if (c >= '0' && c <= '9')
+    {
+      output |= c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+      output |= c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+      output |= c - 'A' + 10;
+    }
+    else
+    {
+      throw parse_error();
+    }
+  }
+  return output;
+}
+
+void reader::escape(std::string &output)
+{
+  int const c = input.sbumpc();
+  switch (c)
+  {
+  case '"':
+  case '\\':
+  case '/':
+    output.push_back(static_cast< char >(c));
+    return;
+  case 'b':
+    output.push_back('\b');
+    return;
+  case 'f':
+    output.push_back('\f');
+    return;
+  case 'n':
+    output.push_back('\n');
+    return;
+  case 'r':
+    output.push_back('\r');
+    return;
+  case 't':
+    output.push_back('\t');
+    return;
+  case 'u':
+    break;
+  default:
+    throw parse_error();
+  }
+
+  unsigned long codepoint = read_hex(input);
+  if (codepoint >= 0xD800 && codepoint < 0xDC00)
+  {
+    if (input.sbumpc() != '\\' || input.sbumpc() != 'u')
+    {
+      throw parse_error();
+    }
+    unsigned long const low = read_hex(input);
+    if (low < 0xDC00 || low >= 0xE000)
+    {
+      throw parse_error();
+    }
+    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+  }
+
+  if (codepoint < 0x80)
+  {
+    output.push_back(static_cast< char >(codepoint));
+  }
+  else if (codepoint < 0x800)
+  {
+    output.push_back(static_cast< char >(0xC0 | (codepoint >> 6)));
+    output.push_back(static_cast< char >(0x80 | (codepoint & 0x3F)));
+  }
+  else if (codepoint < 0x10000)
+  {
+    output.push_back(static_cast< char >(0xE0 | (codepoint >> 12)));
+    output.push_back(static_cast< char >(0x80 | ((codepoint >> 6) & 0x3F)));
+    output.push_back(static_cast< char >(0x80 | (codepoint & 0x3F)));
+  }
+  else
+  {
+    output.push_back(static_cast< char >(0xF0 | (codepoint >> 18)));
+    output.push_back(static_cast< char >(0x80 | ((codepoint >> 12) & 0x3F)));
+    output.push_back(static_cast< char >(0x80 | ((codepoint >> 6) & 0x3F)));
+    output.push_back(static_cast< char >(0x80 | (codepoint & 0x3F)));
+  }
+}
+}
@@ -0,0 +1,114 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_JSON_HPP_INCLUDED
+#define BACKEND_JSON_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <streambuf>
+#include <stdexcept>
+
+namespace json
+{
+/// \brief Streaming JSON writer.
+///
+/// Output is written straight to the given stream without building a document in memory. The
+/// layout (indentation, escaping, trailing newline) is the one of
+/// `boost::property_tree::write_json()`, so documents written by either are byte identical.
+class writer
+{
+public:
+  /// \brief Layout of written documents.
+  enum layout_type
+  {
+    /// \brief Indented over several lines like `boost::property_tree::write_json()`.
+    LAYOUT_INDENTED,
+    /// \brief Each document on a single line, as in JSON Lines.
+    LAYOUT_LINE
+  };
+
+  /// \brief Write to the given stream.
+  explicit writer(std::ostream &output);
+
+  /// \brief Write to the given stream in the given layout.
+  writer(std::ostream &output, layout_type layout);
+
+  /// \brief Write a single array element on its own, as if nested at the given depth.
+  ///
+  /// The element is written without separator and trailing newline, to be passed to element() of
+  /// a writer at the same depth later.
+  writer(std::ostream &output, std::size_t depth);
+
+  /// \brief Open an object, either the document root or an array element.
+  void begin_object();
+  /// \brief Open an array as member of the current object.
+  void begin_array(char const *key);
+  /// \brief Close the current object, closing the root terminates the document.
+  void end_object();
+  /// \brief Close the current array.
+  void end_array();
+  /// \brief Write a string member of the current object.
+  void value(char const *key, std::string const &value);
+  /// \brief Write an element of the current array serialized by a writer at depth().
+  void element(std::string const &text);
+  /// \brief Nesting depth of the current array or object.
+  std::size_t depth() const;
+
+private:
+  void separate();
+  void close(char c);
+  void quoted(std::string const &value);
+
+  std::ostream &output;
+  std::vector< bool > first;
+  /// \brief Depth of the element written on its own, 0 for documents.
+  std::size_t const base;
+  /// \brief Whether documents are indented, see LAYOUT_INDENTED.
+  bool const indent;
+};
+
+/// \brief Streaming JSON reader.
+///
+/// Tokens are pulled from the given stream buffer one at a time, so callers can decode documents
+/// directly into their own data structures. Throws parse_error on malformed input.
+class reader
+{
+public:
+  /// \brief Read from the given stream buffer.
+  explicit reader(std::streambuf &input);
+
+  /// \brief Consume the given structural character if it is next, skipping whitespace.
+  bool next(char c);
+  /// \brief Consume the given structural character, skipping whitespace.
+  void expect(char c);
+  /// \brief Read a string token into `output`.
+  void string(std::string &output);
+  /// \brief Read a string, number, boolean or null token in its textual form into `output`.
+  void scalar(std::string &output);
+  /// \brief Skip a complete value of any type.
+  void skip();
+  /// \brief Whether nothing but whitespace is left.
+  bool done();
+  /// \brief Assert that nothing but whitespace is left.
+  void finish();
+
+private:
+  int peek();
+  void escape(std::string &output);
+
+  std::streambuf &input;
+};
+
+/// \brief Error to be thrown if the input is not valid JSON.
+class parse_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  parse_error() : std::runtime_error("malformed json") {}
+};
+}
+
+#endif // BACKEND_JSON_HPP_INCLUDED
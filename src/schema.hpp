@@ -0,0 +1,135 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_SCHEMA_HPP_INCLUDED
+#define BACKEND_SCHEMA_HPP_INCLUDED
+
+#include "walley.hpp"
+#include <boost/type_traits/remove_const.hpp>
+
+namespace schema
+{
+/// \brief Reference to a field holding binary data.
+///
+/// Text formats persist the field base64 encoded, binary formats store the bytes as they are.
+template < typename S >
+struct blob
+{
+  /// \brief Refer to the given field.
+  explicit blob(S &text) : text(text) {}
+
+  /// \brief Referred field.
+  S &text;
+};
+
+/// \brief Refer to a field holding binary data, see blob.
+template < typename S >
+blob< S > make_blob(S &text)
+{
+  return blob< S >(text);
+}
+
+/// \brief Persisted fields of a stored element type.
+///
+/// Every specialization provides the number of persisted fields, whether any of them is a blob,
+/// and a `visit()` function that calls `visitor(name, field)` for each of them in the order they
+/// are written to disk. The visited element may be const or mutable, so the same description
+/// serves readers and writers.
+template < typename T >
+struct fields;
+
+template <>
+struct fields< walley::login_type >
+{
+  static std::size_t const count = 7;
+  static bool const blobs = false;
+
+  template < typename Element, typename Visitor >
+  static void visit(Element &value, Visitor &visitor)
+  {
+    visitor("uid", value.uid);
+    visitor("title", value.title);
+    visitor("category", value.category);
+    visitor("username", value.username);
+    visitor("password", value.password);
+    visitor("url", value.url);
+    visitor("last_change", value.last_change);
+  }
+};
+
+template <>
+struct fields< walley::note_type >
+{
+  static std::size_t const count = 4;
+  static bool const blobs = false;
+
+  template < typename Element, typename Visitor >
+  static void visit(Element &value, Visitor &visitor)
+  {
+    visitor("uid", value.uid);
+    visitor("title", value.title);
+    visitor("category", value.category);
+    visitor("content", value.content);
+  }
+};
+
+template <>
+struct fields< walley::file_type >
+{
+  static std::size_t const count = 4;
+  static bool const blobs = true;
+
+  template < typename Element, typename Visitor >
+  static void visit(Element &value, Visitor &visitor)
+  {
+    visitor("uid", value.uid);
+    visitor("title", value.title);
+    visitor("category", value.category);
+    visitor("content", make_blob(value.content));
+  }
+};
+
+template <>
+struct fields< walley::contact_type >
+{
+  static std::size_t const count = 11;
+  static bool const blobs = false;
+
+  template < typename Element, typename Visitor >
+  static void visit(Element &value, Visitor &visitor)
+  {
+    visitor("uid", value.uid);
+    visitor("category", value.category);
+    visitor("first_name", value.first_name);
+    visitor("last_name", value.last_name);
+    visitor("email", value.email);
+    visitor("phone", value.phone);
+    visitor("street", value.street);
+    visitor("zip", value.zip);
+    visitor("city", value.city);
+    visitor("country", value.country);
+    visitor("comment", value.comment);
+  }
+};
+
+/// \brief Whether a field belongs to the summary of an element.
+///
+/// The summary consists of everything needed to navigate a store without access to the element
+/// itself: unique id, category and the fields its title is made of.
+inline bool summary(char const *name)
+{
+  std::string const field(name);
+  return field == "uid" || field == "category" || field == "title" || field == "first_name" ||
+         field == "last_name";
+}
+
+/// \brief Visit all persisted fields of an element, see fields.
+template < typename Element, typename Visitor >
+void visit(Element &value, Visitor &visitor)
+{
+  fields< typename boost::remove_const< Element >::type >::visit(value, visitor);
+}
+}
+
+#endif // BACKEND_SCHEMA_HPP_INCLUDED
@@ -0,0 +1,199 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "search.hpp"
+#include <boost/foreach.hpp>
+#include <algorithm>
+
+namespace search
+{
+/// \brief Number of dead entries tolerated before rebuilding regardless of live documents.
+static std::size_t const min_dead = 1024;
+
+static std::string fold_case(std::string text)
+{
+  for (std::size_t k = 0; k < text.size(); ++k)
+  {
+    if (text[k] >= 'A' && text[k] <= 'Z')
+    {
+      text[k] = static_cast< char >(text[k] - 'A' + 'a');
+    }
+  }
+  return text;
+}
+
+static boost::uint32_t trigram(char const *text)
+{
+  return static_cast< boost::uint32_t >(static_cast< unsigned char >(text[0])) << 16 |
+         static_cast< boost::uint32_t >(static_cast< unsigned char >(text[1])) << 8 |
+         static_cast< boost::uint32_t >(static_cast< unsigned char >(text[2]));
+}
+
+static bool shorter(std::vector< boost::uint32_t > const *lhs,
+                    std::vector< boost::uint32_t > const *rhs)
+{
+  return lhs->size() < rhs->size();
+}
+
+void index::insert(std::string const &uid, std::string const &text)
+{
+  erase(uid);
+
+  boost::uint32_t const number = static_cast< boost::uint32_t >(documents.size());
+  documents.push_back(document());
+  documents.back().uid = uid;
+  documents.back().text = fold_case(text);
+  numbers[uid] = number;
+
+  std::string const &folded = documents.back().text;
+  for (std::size_t k = 0; k + 3 <= folded.size(); ++k)
+  {
+    // Numbers only grow, so appending keeps each list sorted and free of duplicates.
+    std::vector< boost::uint32_t > &list = postings[trigram(&folded[k])];
+    if (list.empty() || list.back() != number)
+    {
+      list.push_back(number);
+    }
+  }
+}
+
+void index::erase(std::string const &uid)
+{
+  boost::unordered_map< std::string, boost::uint32_t >::iterator it = numbers.find(uid);
+  if (it == numbers.end())
+  {
+    return;
+  }
+
+  document &dead = documents[it->second];
+  dead.uid.clear();
+  std::string().swap(dead.text);
+  numbers.erase(it);
+
+  std::size_t const dead_count = documents.size() - numbers.size();
+  if (dead_count > min_dead && dead_count > numbers.size())
+  {
+    rebuild();
+  }
+}
+
+std::vector< std::string > index::find(std::string const &query) const
+{
+  std::vector< std::string > output;
+  std::string const folded = fold_case(query);
+
+  if (folded.size() < 3)
+  {
+    BOOST_FOREACH (document const &candidate, documents)
+    {
+      if (!candidate.uid.empty() && candidate.text.find(folded) != std::string::npos)
+      {
+        output.push_back(candidate.uid);
+      }
+    }
+    return output;
+  }
+
+  std::vector< std::vector< boost::uint32_t > const * > lists;
+  for (std::size_t k = 0; k + 3 <= folded.size(); ++k)
+  {
+    boost::unordered_map< boost::uint32_t, std::vector< boost::uint32_t > >::const_iterator it =
+        postings.find(trigram(&folded[k]));
+    if (it == postings.end())
+    {
+      return output;
+    }
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(), shorter);
+
+  // Candidates from the shortest list are checked against the others by binary search.
+  BOOST_FOREACH (boost::uint32_t number, *lists.front())
+  {
+    bool candidate = !documents[number].uid.empty();
+    for (std::size_t k = 1; candidate && k < lists.size(); ++k)
+    {
+      candidate = std::binary_search(lists[k]->begin(), lists[k]->end(), number);
+    }
+
+    // Trigrams may match in a different order, only the text itself tells.
+    if (candidate && documents[number].text.find(folded) != std::string::npos)
+    {
+      output.push_back(documents[number].uid);
+    }
+  }
+  return output;
+}
+
+void index::rebuild()
+{
+  std::vector< document > live;
+  live.swap(documents);
+  numbers.clear();
+  postings.clear();
+  BOOST_FOREACH (document const &entry, live)
+  {
+    if (!entry.uid.empty())
+    {
+      // The text is folded already, which folding again does not change.
+      insert(entry.uid, entry.text);
+    }
+  }
+}
+
+void prefix_index::insert(std::string const &uid, std::string const &title)
+{
+  erase(uid);
+  std::string const folded = fold_case(title);
+  entries.insert(key(folded, uid));
+  titles[uid] = folded;
+}
+
+void prefix_index::erase(std::string const &uid)
+{
+  boost::unordered_map< std::string, std::string >::iterator it = titles.find(uid);
+  if (it != titles.end())
+  {
+    entries.erase(key(it->second, uid));
+    titles.erase(it);
+  }
+}
+
+std::vector< std::string > prefix_index::find(std::string const &prefix, std::size_t count,
+                                              std::string &cursor) const
+{
+  if (count == 0)
+  {
+    return std::vector< std::string >();
+  }
+
+  std::string const folded = fold_case(prefix);
+  std::set< key >::const_iterator it = entries.lower_bound(key(folded, std::string()));
+  if (!cursor.empty())
+  {
+    // Unique ids never contain a line break, so the first one separates them from the title.
+    std::size_t const split = cursor.find('\n');
+    key const last(cursor.substr(split + 1), cursor.substr(0, split));
+    if (it != entries.end() && !(last < *it))
+    {
+      it = entries.upper_bound(last);
+    }
+    cursor.clear();
+  }
+
+  std::vector< std::string > output;
+  for (; it != entries.end() && it->first.compare(0, folded.size(), folded) == 0; ++it)
+  {
+    if (output.size() == count)
+    {
+      // Continue after the last entry returned, there is at least one more match.
+      --it;
+      cursor = it->second + '\n' + it->first;
+      break;
+    }
+    output.push_back(it->second);
+  }
+  return output;
+}
+}
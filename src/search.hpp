@@ -0,0 +1,97 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_SEARCH_HPP_INCLUDED
+#define BACKEND_SEARCH_HPP_INCLUDED
+
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+#include <set>
+
+/// \brief Full-text search by substring.
+namespace search
+{
+/// \brief Trigram index of the text of documents identified by unique ids.
+///
+/// Every three consecutive bytes of a text form a trigram, and the index lists the documents
+/// containing each trigram. A query is answered by intersecting the lists of its trigrams, which
+/// leaves few candidates to be verified by a substring search of their text. Matching ignores the
+/// case of ASCII letters. Updating a document appends it under a new number and leaves the old one
+/// behind as dead entry, so lists stay sorted by appending only. Dead entries are dropped by
+/// rebuilding the index once they outnumber the live documents.
+class index
+{
+public:
+  /// \brief Add a document, or replace the text of a document with the same id.
+  void insert(std::string const &uid, std::string const &text);
+
+  /// \brief Remove a document if present.
+  void erase(std::string const &uid);
+
+  /// \brief Unique ids of all documents containing `query`.
+  ///
+  /// Queries shorter than a trigram are answered by searching the text of all documents.
+  ///
+  /// \param[in] query Text to search for, the empty query matches all documents
+  /// \return Unique ids of matching documents in order of insertion
+  std::vector< std::string > find(std::string const &query) const;
+
+private:
+  /// \brief Text of a document, its unique id is empty for dead entries.
+  struct document
+  {
+    std::string uid;
+    std::string text;
+  };
+
+  void rebuild();
+
+  std::vector< document > documents;
+  /// \brief Number of a live document in `documents` by its unique id.
+  boost::unordered_map< std::string, boost::uint32_t > numbers;
+  /// \brief Sorted numbers of the documents containing a trigram.
+  boost::unordered_map< boost::uint32_t, std::vector< boost::uint32_t > > postings;
+};
+
+/// \brief Sorted index of titles for lookup by prefix.
+///
+/// Titles are kept in a tree ordered by their case folded text and unique id, so all titles
+/// starting with a prefix are adjacent and a page of them costs a logarithmic seek plus the page
+/// itself. Matching ignores the case of ASCII letters.
+class prefix_index
+{
+public:
+  /// \brief Add a title, or replace the title of the entry with the same id.
+  void insert(std::string const &uid, std::string const &title);
+
+  /// \brief Remove an entry if present.
+  void erase(std::string const &uid);
+
+  /// \brief Unique ids of up to `count` entries with titles starting with `prefix`.
+  ///
+  /// Entries are returned in order of their folded titles and then their unique ids, so an exact
+  /// match comes before longer titles. The cursor tells where the previous page ended and stays
+  /// valid across changes to the index.
+  ///
+  /// \param[in] prefix Beginning of the title, the empty prefix matches all entries
+  /// \param[in] count Maximum number of entries to return, the cursor is kept if it is 0
+  /// \param[in,out] cursor Empty for the first page, afterwards set to continue with the next page
+  /// or emptied if there is none
+  /// \return Unique ids of matching entries in order
+  std::vector< std::string > find(std::string const &prefix, std::size_t count,
+                                  std::string &cursor) const;
+
+private:
+  /// \brief Folded title and unique id of an entry.
+  typedef std::pair< std::string, std::string > key;
+
+  std::set< key > entries;
+  /// \brief Folded title of an entry by its unique id.
+  boost::unordered_map< std::string, std::string > titles;
+};
+}
+
+#endif // BACKEND_SEARCH_HPP_INCLUDED
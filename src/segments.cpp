@@ -0,0 +1,213 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "segments.hpp"
+#include "aes.hpp"
+#include "schema.hpp"
+#include "serialization.hpp"
+#include <cstring>
+
+namespace segments
+{
+static char const magic[] = {'\x89', 'W', 'A', 'L', 'L', 'E', 'Y', 'S'};
+static std::size_t const trailer_size = 16;
+
+static void put_uint64(char *output, boost::uint64_t value)
+{
+  for (std::size_t k = 0; k < 8; ++k)
+  {
+    output[k] = static_cast< char >((value >> (8 * k)) & 0xFF);
+  }
+}
+
+static boost::uint64_t get_uint64(char const *input)
+{
+  boost::uint64_t output = 0;
+  for (std::size_t k = 0; k < 8; ++k)
+  {
+    output |= static_cast< boost::uint64_t >(static_cast< unsigned char >(input[k])) << (8 * k);
+  }
+  return output;
+}
+
+/// \brief Nonce of the block at a position, so a block only decrypts where it was written.
+static std::string nonce(boost::uint64_t position)
+{
+  std::string output(aes::nonce_size, 0x0);
+  put_uint64(&output[0], position);
+  return output;
+}
+
+/// \brief Summary of an element as binary values, see schema::summary().
+template < typename T >
+static std::string summary(T const &value)
+{
+  std::string output;
+  auxiliary::output_buffer buffer(output);
+  std::ostream stream(&buffer);
+  binary::writer record(stream);
+  serialization::write_summary(record, value);
+  return output;
+}
+
+bool detect(char const *data, std::size_t size)
+{
+  return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+writer::writer(std::string const &password, std::streambuf &output)
+    : password(password), output(output), position(0), index_buffer(index),
+      index_stream(&index_buffer), index_writer(index_stream)
+{
+  std::string header;
+  {
+    auxiliary::output_buffer buffer(header);
+    std::ostream stream(&buffer);
+    stream.write(magic, sizeof(magic));
+    binary::writer(stream).number(version);
+  }
+  if (output.sputn(header.data(), header.size()) != static_cast< std::streamsize >(header.size()))
+  {
+    throw auxiliary::file_access_error();
+  }
+  position = header.size();
+  index_writer.header();
+}
+
+template < typename T >
+void writer::section(std::vector< T > const &values, std::vector< std::string > &records)
+{
+  index_writer.number(serialization::summary_size< T >());
+  index_writer.number(values.size());
+  std::string scratch;
+  for (std::size_t k = 0; k < values.size(); ++k)
+  {
+    std::string plaintext;
+    {
+      auxiliary::output_buffer buffer(plaintext);
+      std::ostream stream(&buffer);
+      binary::writer segment(stream);
+      segment.number(schema::fields< T >::count);
+      segment.raw(serialization::cached_record(values[k], records[k], scratch));
+    }
+
+    extent const block = write(plaintext);
+    serialization::write_summary(index_writer, values[k]);
+    index_writer.number(block.first);
+    index_writer.number(block.second);
+  }
+}
+
+void writer::finish()
+{
+  index_stream.flush();
+  extent const block = write(index);
+
+  char trailer[trailer_size];
+  put_uint64(trailer, block.first);
+  put_uint64(trailer + 8, block.second);
+  if (output.sputn(trailer, trailer_size) != static_cast< std::streamsize >(trailer_size) ||
+      output.pubsync() != 0)
+  {
+    throw auxiliary::file_access_error();
+  }
+}
+
+extent writer::write(std::string const &plaintext)
+{
+  std::string const ciphertext = aes::seal(password, nonce(position), plaintext);
+  if (output.sputn(ciphertext.data(), ciphertext.size()) !=
+      static_cast< std::streamsize >(ciphertext.size()))
+  {
+    throw auxiliary::file_access_error();
+  }
+
+  extent const block(position, ciphertext.size());
+  position += block.second;
+  return block;
+}
+
+reader::reader(std::string const &password, char const *data, std::size_t size)
+    : password(password), data(data), size(size)
+{
+  if (!detect(data, size) || size < sizeof(magic) + trailer_size)
+  {
+    throw binary::format_error();
+  }
+
+  auxiliary::input_buffer header(data + sizeof(magic), size - sizeof(magic));
+  if (binary::reader(header).number() > version)
+  {
+    throw binary::format_error();
+  }
+
+  extent const block(get_uint64(data + size - trailer_size),
+                     get_uint64(data + size - trailer_size + 8));
+  index = decrypt(block);
+  index_buffer.reset(new auxiliary::input_buffer(index.data(), index.size()));
+  index_reader.reset(new binary::reader(*index_buffer));
+  if (index_reader->header() > binary::version)
+  {
+    throw binary::format_error();
+  }
+}
+
+template < typename T >
+void reader::section(std::vector< T > &summaries, std::vector< extent > &segments)
+{
+  std::size_t const fields = static_cast< std::size_t >(index_reader->number());
+  boost::uint64_t const count = index_reader->number();
+  for (boost::uint64_t k = 0; k < count; ++k)
+  {
+    summaries.push_back(T());
+    serialization::read_summary(*index_reader, summaries.back(), fields);
+    boost::uint64_t const position = index_reader->number();
+    segments.push_back(extent(position, index_reader->number()));
+  }
+}
+
+void reader::finish()
+{
+  index_reader->finish();
+}
+
+template < typename T >
+void reader::element(extent const &segment, T const &entry, T &value) const
+{
+  std::string const plaintext = decrypt(segment);
+  auxiliary::input_buffer buffer(plaintext.data(), plaintext.size());
+  binary::reader record(buffer);
+  std::size_t const fields = static_cast< std::size_t >(record.number());
+  serialization::read(record, value, fields);
+  record.finish();
+
+  // The index may point at the segment of another element, which decrypts just as well.
+  if (summary(value) != summary(entry))
+  {
+    throw binary::format_error();
+  }
+}
+
+std::string reader::decrypt(extent const &block) const
+{
+  if (block.first > size || block.second > size - block.first)
+  {
+    throw binary::format_error();
+  }
+  return aes::open(password, nonce(block.first), data + block.first,
+                   static_cast< std::size_t >(block.second));
+}
+
+#define SEGMENTS_INSTANTIATE(T)                                                                   \
+  template void writer::section< T >(std::vector< T > const &, std::vector< std::string > &);     \
+  template void reader::section< T >(std::vector< T > &, std::vector< extent > &);                \
+  template void reader::element< T >(extent const &, T const &, T &) const;
+
+SEGMENTS_INSTANTIATE(walley::login_type)
+SEGMENTS_INSTANTIATE(walley::note_type)
+SEGMENTS_INSTANTIATE(walley::file_type)
+SEGMENTS_INSTANTIATE(walley::contact_type)
+
+#undef SEGMENTS_INSTANTIATE
+}
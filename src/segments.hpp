@@ -0,0 +1,112 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_SEGMENTS_HPP_INCLUDED
+#define BACKEND_SEGMENTS_HPP_INCLUDED
+
+#include "auxiliary.hpp"
+#include "binary.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <utility>
+
+/// \brief Segmented store layout.
+///
+/// A segmented store consists of a plain header, followed by one encrypted segment per element,
+/// followed by an encrypted index, followed by a trailer holding position and size of the index.
+/// The index lists the summary of each element (see schema::summary()) together with position and
+/// size of its segment. This allows opening a store by decrypting the index only, and decrypting
+/// elements on demand. Each encrypted block is authenticated with AES-GCM under a nonce made of
+/// its position, see aes::seal(), so stores must be written with a fresh key every time.
+namespace segments
+{
+/// \brief Current version of the segmented layout, written after the magic bytes.
+boost::uint64_t const version = 1;
+
+/// \brief Position and size of a segment within the store.
+typedef std::pair< boost::uint64_t, boost::uint64_t > extent;
+
+/// \brief Check whether a blob is a segmented store.
+///
+/// \param[in] data Beginning of blob
+/// \param[in] size Size of blob
+/// \return Whether the blob starts with the magic bytes of a segmented store
+bool detect(char const *data, std::size_t size);
+
+/// \brief Streaming writer for segmented stores.
+///
+/// Segments are encrypted and written as soon as elements are passed in, only the index is kept in
+/// memory until finish() is called.
+class writer
+{
+public:
+  /// \brief Write a store encrypted with the given password to `output`.
+  writer(std::string const &password, std::streambuf &output);
+
+  /// \brief Write segments and index entries of all elements of a content type.
+  ///
+  /// Serialized records are reused from `records`, see serialization::cached_record(), which must
+  /// have one entry per element.
+  template < typename T >
+  void section(std::vector< T > const &values, std::vector< std::string > &records);
+
+  /// \brief Write index and trailer.
+  void finish();
+
+private:
+  extent write(std::string const &plaintext);
+
+  std::string const password;
+  std::streambuf &output;
+  boost::uint64_t position;
+  std::string index;
+  auxiliary::output_buffer index_buffer;
+  std::ostream index_stream;
+  binary::writer index_writer;
+};
+
+/// \brief Reader for segmented stores in memory.
+///
+/// The index is decrypted on construction and consumed section by section, elements are decrypted
+/// individually on request. Throws on malformed input or a wrong password.
+class reader
+{
+public:
+  /// \brief Read a store of `size` bytes starting at `data` encrypted with the given password.
+  ///
+  /// The memory must outlive the reader.
+  reader(std::string const &password, char const *data, std::size_t size);
+
+  /// \brief Read the index entries of the next content type.
+  ///
+  /// For each element, its summary is appended to `summaries` and its segment to `segments`.
+  template < typename T >
+  void section(std::vector< T > &summaries, std::vector< extent > &segments);
+
+  /// \brief Assert that the index has been consumed completely.
+  void finish();
+
+  /// \brief Decrypt and deserialize the element stored in a segment.
+  ///
+  /// Throws binary::format_error if the element does not match `entry`, the summary listed for the
+  /// segment in the index, and aes::integrity_error if the segment has been tampered with.
+  template < typename T >
+  void element(extent const &segment, T const &entry, T &value) const;
+
+private:
+  std::string decrypt(extent const &block) const;
+
+  std::string const password;
+  char const *data;
+  std::size_t size;
+  std::string index;
+  boost::scoped_ptr< auxiliary::input_buffer > index_buffer;
+  boost::scoped_ptr< binary::reader > index_reader;
+};
+}
+
+#endif // BACKEND_SEGMENTS_HPP_INCLUDED
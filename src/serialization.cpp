@@ -0,0 +1,705 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "serialization.hpp"
+#include "schema.hpp"
+#include "base64.hpp"
+#include "auxiliary.hpp"
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <sstream>
+
+namespace serialization
+{
+boost::posix_time::ptime parse_time(std::string const &text)
+{
+  namespace bpt = boost::posix_time;
+
+  // Stream extraction is what boost::property_tree uses, but it constructs a locale facet on each
+  // call and dominates load time, so it is only kept as fallback for unusual formats.
+  if (text == "not-a-date-time")
+  {
+    return bpt::ptime(bpt::not_a_date_time);
+  }
+  else if (text == "+infinity")
+  {
+    return bpt::ptime(bpt::pos_infin);
+  }
+  else if (text == "-infinity")
+  {
+    return bpt::ptime(bpt::neg_infin);
+  }
+
+  try
+  {
+    return bpt::time_from_string(text);
+  }
+  catch (std::exception const &)
+  {
+  }
+
+  bpt::ptime output;
+  std::istringstream stream(text);
+  stream >> output;
+  if (stream.fail() || !(stream >> std::ws).eof())
+  {
+    throw format_error();
+  }
+  return output;
+}
+
+/// \brief Writes visited fields as members of the current JSON object.
+struct json_field_writer
+{
+  explicit json_field_writer(json::writer &output) : output(output) {}
+
+  void operator()(char const *name, std::string const &value)
+  {
+    output.value(name, value);
+  }
+
+  void operator()(char const *name, schema::blob< std::string const > value)
+  {
+    output.value(name, base64::encode(value.text));
+  }
+
+  void operator()(char const *name, boost::posix_time::ptime const &value)
+  {
+    output.value(name, boost::posix_time::to_simple_string(value));
+  }
+
+  json::writer &output;
+};
+
+/// \brief Reads the value of a JSON member into the visited field of the same name.
+struct json_field_reader
+{
+  json_field_reader(json::reader &input, std::string const &key, unsigned long &seen)
+      : input(input), key(key), seen(seen), position(0), found(false)
+  {
+  }
+
+  void operator()(char const *name, std::string &value)
+  {
+    if (match(name))
+    {
+      input.scalar(value);
+    }
+  }
+
+  void operator()(char const *name, schema::blob< std::string > value)
+  {
+    if (match(name))
+    {
+      input.scalar(value.text);
+      if (!value.text.empty())
+      {
+        value.text.resize(base64::decode(value.text.data(), value.text.size(), &value.text[0]));
+      }
+    }
+  }
+
+  void operator()(char const *name, boost::posix_time::ptime &value)
+  {
+    if (match(name))
+    {
+      std::string text;
+      input.scalar(text);
+      value = parse_time(text);
+    }
+  }
+
+  bool match(char const *name)
+  {
+    unsigned long const bit = 1ul << position++;
+    if (found || (seen & bit) || key != name)
+    {
+      return false;
+    }
+    seen |= bit;
+    found = true;
+    return true;
+  }
+
+  json::reader &input;
+  std::string const &key;
+  unsigned long &seen;
+  std::size_t position;
+  bool found;
+};
+
+/// \brief Writes visited fields as consecutive binary values.
+///
+/// Every field is a length-prefixed value, so readers can skip fields they do not know. Timestamps
+/// are a value holding a tag for special values followed by the microseconds since epoch.
+struct binary_field_writer
+{
+  explicit binary_field_writer(binary::writer &output) : output(output) {}
+
+  void operator()(char const *, std::string const &value)
+  {
+    output.value(value);
+  }
+
+  void operator()(char const *, schema::blob< std::string const > value)
+  {
+    output.value(value.text);
+  }
+
+  void operator()(char const *, boost::posix_time::ptime const &value)
+  {
+    std::string encoded;
+    {
+      auxiliary::output_buffer buffer(encoded);
+      std::ostream stream(&buffer);
+      binary::writer time(stream);
+      if (value.is_not_a_date_time())
+      {
+        time.number(0);
+      }
+      else if (value.is_pos_infinity())
+      {
+        time.number(1);
+      }
+      else if (value.is_neg_infinity())
+      {
+        time.number(2);
+      }
+      else
+      {
+        boost::int64_t const ticks = (value - epoch()).total_microseconds();
+        time.number(3);
+        time.number((static_cast< boost::uint64_t >(ticks) << 1) ^
+                    static_cast< boost::uint64_t >(ticks >> 63));
+      }
+    }
+    output.value(encoded);
+  }
+
+  static boost::posix_time::ptime epoch()
+  {
+    return boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1));
+  }
+
+  binary::writer &output;
+};
+
+/// \brief Reads consecutive binary values into the visited fields, see binary_field_writer.
+struct binary_field_reader
+{
+  explicit binary_field_reader(binary::reader &input) : input(input) {}
+
+  void operator()(char const *, std::string &value)
+  {
+    input.value(value);
+  }
+
+  void operator()(char const *, schema::blob< std::string > value)
+  {
+    input.value(value.text);
+  }
+
+  void operator()(char const *, boost::posix_time::ptime &value)
+  {
+    input.value(encoded);
+    auxiliary::input_buffer buffer(encoded.data(), encoded.size());
+    binary::reader time(buffer);
+    switch (time.number())
+    {
+    case 0:
+      value = boost::posix_time::ptime(boost::posix_time::not_a_date_time);
+      break;
+    case 1:
+      value = boost::posix_time::ptime(boost::posix_time::pos_infin);
+      break;
+    case 2:
+      value = boost::posix_time::ptime(boost::posix_time::neg_infin);
+      break;
+    case 3:
+    {
+      boost::uint64_t const zigzag = time.number();
+      boost::int64_t const ticks =
+          static_cast< boost::int64_t >(zigzag >> 1) ^ -static_cast< boost::int64_t >(zigzag & 1);
+      value = binary_field_writer::epoch() + boost::posix_time::microseconds(ticks);
+      break;
+    }
+    default:
+      throw format_error();
+    }
+    time.finish();
+  }
+
+  binary::reader &input;
+  /// \brief Value of the timestamp being read.
+  std::string encoded;
+};
+
+/// \brief Writes the names of visited fields as CSV row.
+struct csv_header_writer
+{
+  explicit csv_header_writer(csv::writer &output) : output(output) {}
+
+  template < typename V >
+  void operator()(char const *name, V const &)
+  {
+    output.field(name);
+  }
+
+  csv::writer &output;
+};
+
+/// \brief Writes visited fields as CSV row.
+struct csv_field_writer
+{
+  explicit csv_field_writer(csv::writer &output) : output(output) {}
+
+  void operator()(char const *, std::string const &value)
+  {
+    output.field(value);
+  }
+
+  void operator()(char const *, schema::blob< std::string const > value)
+  {
+    output.field(base64::encode(value.text));
+  }
+
+  void operator()(char const *, boost::posix_time::ptime const &value)
+  {
+    output.field(boost::posix_time::to_simple_string(value));
+  }
+
+  csv::writer &output;
+};
+
+/// \brief Finds the columns of visited fields in a CSV header row.
+struct csv_column_finder
+{
+  explicit csv_column_finder(std::vector< std::string > const &header) : header(header) {}
+
+  template < typename V >
+  void operator()(char const *name, V const &)
+  {
+    std::vector< std::string >::const_iterator it = std::find(header.begin(), header.end(), name);
+    columns.push_back(it == header.end() ? std::string::npos : it - header.begin());
+  }
+
+  std::vector< std::string > const &header;
+  std::vector< std::size_t > columns;
+};
+
+/// \brief Reads visited fields from the columns of a CSV row.
+struct csv_field_reader
+{
+  csv_field_reader(std::vector< std::string > &row, std::vector< std::size_t > const &columns)
+      : row(row), columns(columns), position(0)
+  {
+  }
+
+  void operator()(char const *, std::string &value)
+  {
+    if (std::string *text = column())
+    {
+      value.swap(*text);
+    }
+  }
+
+  void operator()(char const *, schema::blob< std::string > value)
+  {
+    if (std::string *text = column())
+    {
+      value.text.swap(*text);
+      if (!value.text.empty())
+      {
+        value.text.resize(base64::decode(value.text.data(), value.text.size(), &value.text[0]));
+      }
+    }
+  }
+
+  void operator()(char const *, boost::posix_time::ptime &value)
+  {
+    std::string *text = column();
+    if (text && !text->empty())
+    {
+      value = parse_time(*text);
+    }
+  }
+
+  /// \brief Column of the next field, null if it has none.
+  std::string *column()
+  {
+    std::size_t const k = columns[position++];
+    return k < row.size() ? &row[k] : 0;
+  }
+
+  std::vector< std::string > &row;
+  std::vector< std::size_t > const &columns;
+  std::size_t position;
+};
+
+/// \brief Passes summary fields on to another binary field visitor, see schema::summary().
+template < typename Visitor >
+struct summary_field_filter
+{
+  explicit summary_field_filter(Visitor &visitor) : visitor(visitor) {}
+
+  template < typename V >
+  void operator()(char const *name, V &value)
+  {
+    if (schema::summary(name))
+    {
+      visitor(name, value);
+    }
+  }
+
+  template < typename S >
+  void operator()(char const *, schema::blob< S >)
+  {
+  }
+
+  Visitor &visitor;
+};
+
+template < typename T >
+void write(json::writer &output, T const &value)
+{
+  output.begin_object();
+  write_members(output, value);
+  output.end_object();
+}
+
+template < typename T >
+void read(json::reader &input, T &value)
+{
+  std::string key;
+  unsigned long seen = 0;
+  input.expect('{');
+  if (!input.next('}'))
+  {
+    do
+    {
+      input.string(key);
+      input.expect(':');
+      json_field_reader field(input, key, seen);
+      schema::visit(value, field);
+      if (!field.found)
+      {
+        input.skip();
+      }
+    } while (input.next(','));
+    input.expect('}');
+  }
+  if (seen != (1ul << schema::fields< T >::count) - 1)
+  {
+    throw format_error();
+  }
+}
+
+template < typename T >
+void write_members(json::writer &output, T const &value)
+{
+  json_field_writer field(output);
+  schema::visit(value, field);
+}
+
+template < typename T >
+void read_members(json::reader &input, T &value)
+{
+  std::string key;
+  unsigned long seen = 0;
+  while (input.next(','))
+  {
+    input.string(key);
+    input.expect(':');
+    json_field_reader field(input, key, seen);
+    schema::visit(value, field);
+    if (!field.found)
+    {
+      input.skip();
+    }
+  }
+  input.expect('}');
+}
+
+template < typename T >
+void write_header(csv::writer &output)
+{
+  T const value = T();
+  csv_header_writer field(output);
+  schema::visit(value, field);
+  output.end_row();
+}
+
+template < typename T >
+void write(csv::writer &output, T const &value)
+{
+  csv_field_writer field(output);
+  schema::visit(value, field);
+  output.end_row();
+}
+
+template < typename T >
+std::vector< std::size_t > columns(std::vector< std::string > const &header)
+{
+  T const value = T();
+  csv_column_finder finder(header);
+  schema::visit(value, finder);
+  return finder.columns;
+}
+
+template < typename T >
+void read(std::vector< std::string > &row, std::vector< std::size_t > const &columns, T &value)
+{
+  csv_field_reader field(row, columns);
+  schema::visit(value, field);
+}
+
+template < typename T >
+void write(binary::writer &output, T const &value)
+{
+  binary_field_writer field(output);
+  schema::visit(value, field);
+}
+
+template < typename T >
+void read(binary::reader &input, T &value, std::size_t fields)
+{
+  if (fields < schema::fields< T >::count)
+  {
+    throw format_error();
+  }
+  binary_field_reader field(input);
+  schema::visit(value, field);
+  for (std::size_t k = schema::fields< T >::count; k < fields; ++k)
+  {
+    input.skip();
+  }
+}
+
+template < typename T >
+void write_summary(binary::writer &output, T const &value)
+{
+  binary_field_writer field(output);
+  summary_field_filter< binary_field_writer > filter(field);
+  schema::visit(value, filter);
+}
+
+template < typename T >
+void read_summary(binary::reader &input, T &value, std::size_t fields)
+{
+  if (fields < summary_size< T >())
+  {
+    throw format_error();
+  }
+  binary_field_reader field(input);
+  summary_field_filter< binary_field_reader > filter(field);
+  schema::visit(value, filter);
+  for (std::size_t k = summary_size< T >(); k < fields; ++k)
+  {
+    input.skip();
+  }
+}
+
+/// \brief Counts visited fields.
+struct field_counter
+{
+  field_counter() : count(0) {}
+
+  template < typename V >
+  void operator()(char const *, V const &)
+  {
+    ++count;
+  }
+
+  std::size_t count;
+};
+
+template < typename T >
+std::size_t summary_size()
+{
+  T const value = T();
+  field_counter counter;
+  summary_field_filter< field_counter > filter(counter);
+  schema::visit(value, filter);
+  return counter.count;
+}
+
+template < typename T >
+void write_section(json::writer &output, char const *name, std::vector< T > const &values)
+{
+  if (values.empty())
+  {
+    output.value(name, "");
+    return;
+  }
+
+  output.begin_array(name);
+  BOOST_FOREACH (T const &value, values)
+  {
+    write(output, value);
+  }
+  output.end_array();
+}
+
+template < typename T >
+void read_section(json::reader &input, std::vector< T > &values)
+{
+  if (!input.next('['))
+  {
+    std::string ignored;
+    input.scalar(ignored);
+    return;
+  }
+  if (!input.next(']'))
+  {
+    do
+    {
+      values.push_back(T());
+      read(input, values.back());
+    } while (input.next(','));
+    input.expect(']');
+  }
+}
+
+template < typename T >
+void write_section(binary::writer &output, std::vector< T > const &values)
+{
+  output.number(schema::fields< T >::count);
+  output.number(values.size());
+  BOOST_FOREACH (T const &value, values)
+  {
+    write(output, value);
+  }
+}
+
+/// \brief Whether a serialized element of type `T` may be kept in a cache, see cached_record().
+template < typename T >
+static bool cacheable(std::string const &serialized)
+{
+  return !schema::fields< T >::blobs && serialized.size() <= max_cached_size;
+}
+
+template < typename T >
+void write_section(json::writer &output, char const *name, std::vector< T > const &values,
+                   std::vector< std::string > &cache)
+{
+  if (values.empty())
+  {
+    output.value(name, "");
+    return;
+  }
+
+  std::string scratch;
+  output.begin_array(name);
+  for (std::size_t k = 0; k < values.size(); ++k)
+  {
+    if (!cache[k].empty())
+    {
+      output.element(cache[k]);
+      continue;
+    }
+
+    scratch.clear();
+    {
+      auxiliary::output_buffer buffer(scratch);
+      std::ostream stream(&buffer);
+      json::writer element(stream, output.depth());
+      write(element, values[k]);
+    }
+    if (cacheable< T >(scratch))
+    {
+      cache[k].swap(scratch);
+      output.element(cache[k]);
+    }
+    else
+    {
+      output.element(scratch);
+    }
+  }
+  output.end_array();
+}
+
+template < typename T >
+void write_section(binary::writer &output, std::vector< T > const &values,
+                   std::vector< std::string > &cache)
+{
+  std::string scratch;
+  output.number(schema::fields< T >::count);
+  output.number(values.size());
+  for (std::size_t k = 0; k < values.size(); ++k)
+  {
+    output.raw(cached_record(values[k], cache[k], scratch));
+  }
+}
+
+template < typename T >
+std::string const &cached_record(T const &value, std::string &cache, std::string &scratch)
+{
+  if (!cache.empty())
+  {
+    return cache;
+  }
+
+  scratch.clear();
+  {
+    auxiliary::output_buffer buffer(scratch);
+    std::ostream stream(&buffer);
+    binary::writer record(stream);
+    write(record, value);
+  }
+  if (!cacheable< T >(scratch))
+  {
+    return scratch;
+  }
+  cache.swap(scratch);
+  return cache;
+}
+
+template < typename T >
+void read_section(binary::reader &input, std::vector< T > &values)
+{
+  // Do not trust the record count for reserving more than a sane amount up front.
+  std::size_t const max_reserve = 1 << 16;
+
+  std::size_t const fields = static_cast< std::size_t >(input.number());
+  boost::uint64_t const count = input.number();
+  values.reserve(values.size() + static_cast< std::size_t >(std::min< boost::uint64_t >(
+                                     count, max_reserve)));
+  for (boost::uint64_t k = 0; k < count; ++k)
+  {
+    values.push_back(T());
+    read(input, values.back(), fields);
+  }
+}
+
+#define SERIALIZATION_INSTANTIATE(T)                                                              \
+  template void write< T >(json::writer &, T const &);                                            \
+  template void read< T >(json::reader &, T &);                                                   \
+  template void write_members< T >(json::writer &, T const &);                                    \
+  template void read_members< T >(json::reader &, T &);                                           \
+  template void write_header< T >(csv::writer &);                                                 \
+  template void write< T >(csv::writer &, T const &);                                             \
+  template std::vector< std::size_t > columns< T >(std::vector< std::string > const &);           \
+  template void read< T >(std::vector< std::string > &, std::vector< std::size_t > const &, T &); \
+  template void write< T >(binary::writer &, T const &);                                          \
+  template void read< T >(binary::reader &, T &, std::size_t);                                    \
+  template void write_summary< T >(binary::writer &, T const &);                                  \
+  template void read_summary< T >(binary::reader &, T &, std::size_t);                            \
+  template std::size_t summary_size< T >();                                                       \
+  template void write_section< T >(json::writer &, char const *, std::vector< T > const &);       \
+  template void read_section< T >(json::reader &, std::vector< T > &);                            \
+  template void write_section< T >(binary::writer &, std::vector< T > const &);                   \
+  template void read_section< T >(binary::reader &, std::vector< T > &);                          \
+  template void write_section< T >(json::writer &, char const *, std::vector< T > const &,        \
+                                   std::vector< std::string > &);                                 \
+  template void write_section< T >(binary::writer &, std::vector< T > const &,                    \
+                                   std::vector< std::string > &);                                 \
+  template std::string const &cached_record< T >(T const &, std::string &, std::string &);
+
+SERIALIZATION_INSTANTIATE(walley::login_type)
+SERIALIZATION_INSTANTIATE(walley::note_type)
+SERIALIZATION_INSTANTIATE(walley::file_type)
+SERIALIZATION_INSTANTIATE(walley::contact_type)
+
+#undef SERIALIZATION_INSTANTIATE
+}
@@ -0,0 +1,143 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef BACKEND_SERIALIZATION_HPP_INCLUDED
+#define BACKEND_SERIALIZATION_HPP_INCLUDED
+
+#include "json.hpp"
+#include "binary.hpp"
+#include "csv.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace serialization
+{
+/// \brief Write an element as JSON object.
+template < typename T >
+void write(json::writer &output, T const &value);
+
+/// \brief Read an element from a JSON object, all persisted fields are required.
+template < typename T >
+void read(json::reader &input, T &value);
+
+/// \brief Write the fields of an element as members of the current JSON object.
+template < typename T >
+void write_members(json::writer &output, T const &value);
+
+/// \brief Read the remaining members of the current JSON object into an element.
+///
+/// Expects the input after a member, and consumes the following members and the closing brace.
+/// Unknown members are skipped, fields without member are left untouched.
+template < typename T >
+void read_members(json::reader &input, T &value);
+
+/// \brief Write the names of the fields of an element as CSV row.
+template < typename T >
+void write_header(csv::writer &output);
+
+/// \brief Write an element as CSV row, see write_header().
+template < typename T >
+void write(csv::writer &output, T const &value);
+
+/// \brief Columns of the fields of an element in a CSV header row, `npos` for missing ones.
+template < typename T >
+std::vector< std::size_t > columns(std::vector< std::string > const &header);
+
+/// \brief Read an element from a CSV row with the given columns, see columns().
+///
+/// Fields without column are left untouched, as are times with an empty column. The fields taken
+/// over are left with unspecified content in `row`.
+template < typename T >
+void read(std::vector< std::string > &row, std::vector< std::size_t > const &columns, T &value);
+
+/// \brief Write an element as binary record.
+template < typename T >
+void write(binary::writer &output, T const &value);
+
+/// \brief Read an element from a binary record consisting of `fields` values.
+///
+/// Records written by a newer version may carry additional fields, which are skipped.
+template < typename T >
+void read(binary::reader &input, T &value, std::size_t fields);
+
+/// \brief Write the summary of an element as binary values, see schema::summary().
+template < typename T >
+void write_summary(binary::writer &output, T const &value);
+
+/// \brief Read the summary of an element from `fields` binary values.
+///
+/// Other fields of the element are left untouched. Summaries written by a newer version may carry
+/// additional fields, which are skipped.
+template < typename T >
+void read_summary(binary::reader &input, T &value, std::size_t fields);
+
+/// \brief Number of fields in the summary of an element.
+template < typename T >
+std::size_t summary_size();
+
+/// \brief Write elements as JSON array member of the current object.
+///
+/// Like boost::property_tree, an empty array is written as an empty string.
+template < typename T >
+void write_section(json::writer &output, char const *name, std::vector< T > const &values);
+
+/// \brief Append elements from a JSON array (or empty string) to `values`.
+template < typename T >
+void read_section(json::reader &input, std::vector< T > &values);
+
+/// \brief Write elements as binary section, prefixed by field and record count.
+template < typename T >
+void write_section(binary::writer &output, std::vector< T > const &values);
+
+/// \brief Write elements as JSON array member, reusing already serialized elements.
+///
+/// Like write_section(json::writer &, char const *, std::vector< T > const &), but element `k` is
+/// copied from `cache[k]` unless empty, in which case it is serialized and stored there if it is
+/// cacheable, see cached_record(). The cache must have one entry per element.
+template < typename T >
+void write_section(json::writer &output, char const *name, std::vector< T > const &values,
+                   std::vector< std::string > &cache);
+
+/// \brief Write elements as binary section, reusing already serialized records.
+///
+/// Like write_section(binary::writer &, std::vector< T > const &), with a cache as for JSON.
+template < typename T >
+void write_section(binary::writer &output, std::vector< T > const &values,
+                   std::vector< std::string > &cache);
+
+/// \brief Largest serialized element kept in the caches of write_section() and cached_record().
+std::size_t const max_cached_size = 4096;
+
+/// \brief Binary record of an element, reusing it from `cache` unless empty.
+///
+/// A fresh record is stored in `cache` if it is cacheable, that is at most max_cached_size bytes
+/// and of a type without blobs, so caches never hold large elements or file contents. Otherwise
+/// it is serialized into `scratch`.
+///
+/// \param[in] value Element to be serialized
+/// \param[in,out] cache Cached record of the element, empty if not serialized yet
+/// \param[out] scratch Storage of records which are not cacheable
+/// \return Record of the element
+template < typename T >
+std::string const &cached_record(T const &value, std::string &cache, std::string &scratch);
+
+/// \brief Append elements from a binary section to `values`.
+template < typename T >
+void read_section(binary::reader &input, std::vector< T > &values);
+
+/// \brief Inverse of `boost::posix_time::to_simple_string()`.
+boost::posix_time::ptime parse_time(std::string const &text);
+
+/// \brief Error to be thrown if a record does not match the persisted fields of its type.
+class format_error : public std::runtime_error
+{
+public:
+  /// \brief Automatically set error appropriate error message.
+  format_error() : std::runtime_error("malformed element") {}
+};
+}
+
+#endif // BACKEND_SERIALIZATION_HPP_INCLUDED
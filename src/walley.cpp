@@ -6,17 +6,30 @@
 #include "aes.hpp"
 #include "auxiliary.hpp"
 #include "base64.hpp"
-#include <boost/property_tree/json_parser.hpp>
+#include "schema.hpp"
+#include "serialization.hpp"
+#include "csv.hpp"
+#include "segments.hpp"
+#include "envelope.hpp"
+#include "journal.hpp"
+#include "search.hpp"
+#include "autofill.hpp"
 #include <boost/foreach.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
-#include <boost/lexical_cast.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/locks.hpp>
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 
 namespace walley
 {
+/// \brief Number of elements added at once by imports.
+static std::size_t const import_batch = 4096;
+
 class corrupted_input_error : public std::runtime_error
 {
 public:
@@ -29,388 +42,1842 @@ public:
   invalid_lookup_error() : std::runtime_error("invalid lookup") {}
 };
 
-void container::load(std::string const &password, std::string const &input)
+static std::string const &element_title(login_type const &value)
 {
-  namespace pt = boost::property_tree;
+  return value.title;
+}
 
-  clear();
+static std::string const &element_title(note_type const &value)
+{
+  return value.title;
+}
+
+static std::string const &element_title(file_type const &value)
+{
+  return value.title;
+}
+
+static std::string element_title(contact_type const &value)
+{
+  return value.title();
+}
+
+static std::string searchable_text(login_type const &value)
+{
+  return value.title + '\n' + value.username + '\n' + value.url;
+}
+
+static std::string searchable_text(note_type const &value)
+{
+  return value.title + '\n' + value.content;
+}
+
+static std::string searchable_text(file_type const &value)
+{
+  return value.title;
+}
+
+static std::string searchable_text(contact_type const &value)
+{
+  return value.first_name + '\n' + value.last_name + '\n' + value.email + '\n' + value.phone +
+         '\n' + value.street + '\n' + value.zip + '\n' + value.city + '\n' + value.country +
+         '\n' + value.comment;
+}
+
+/// \brief Collects the addresses of visited fields, used by exchange().
+struct field_collector
+{
+  template < typename V >
+  void operator()(char const *, V &value)
+  {
+    fields.push_back(&value);
+  }
+
+  void operator()(char const *, schema::blob< std::string > value)
+  {
+    fields.push_back(&value.text);
+  }
+
+  std::vector< void * > fields;
+};
+
+/// \brief Exchanges visited fields with the ones collected from another element of the same type.
+struct field_exchanger
+{
+  explicit field_exchanger(std::vector< void * > const &fields) : fields(fields), position(0) {}
+
+  template < typename V >
+  void operator()(char const *, V &value)
+  {
+    std::swap(value, *static_cast< V * >(fields[position++]));
+  }
+
+  void operator()(char const *, schema::blob< std::string > value)
+  {
+    value.text.swap(*static_cast< std::string * >(fields[position++]));
+  }
+
+  std::vector< void * > const &fields;
+  std::size_t position;
+};
+
+/// \brief Exchange the persisted fields of two elements, which moves text without copying it.
+template < typename T >
+static void exchange(T &lhs, T &rhs)
+{
+  field_collector collector;
+  schema::visit(rhs, collector);
+  field_exchanger exchanger(collector.fields);
+  schema::visit(lhs, exchanger);
+}
+
+/// \brief Random unique id not in use by any element of `slots`.
+///
+/// Drawing an id in use is next to impossible with 122 random bits, but would leave one of the two
+/// elements unreachable, so such an id is drawn again.
+static std::string unique_id(boost::uuids::random_generator &generate,
+                             boost::unordered_map< std::string, std::size_t > const &slots)
+{
+  std::string output = boost::uuids::to_string(generate());
+  while (slots.count(output))
+  {
+    output = boost::uuids::to_string(generate());
+  }
+  return output;
+}
+
+template < typename T >
+void container::storage< T >::rebuild()
+{
+  slots.clear();
+  by_category.clear();
+  records.clear();
+  text.reset();
+  titles.reset();
+  for (std::size_t k = 0; k < elements.size(); ++k)
+  {
+    if (slots.insert(std::make_pair(elements[k].uid, k)).second)
+    {
+      index(elements[k]);
+    }
+  }
+}
+
+struct container::vault
+{
+  vault(std::string const &key, std::string const &input, std::size_t offset)
+      : input(input), index(key, this->input.data() + offset, this->input.size() - offset)
+  {
+  }
+
+  vault(std::string const &key, boost::iostreams::mapped_file_source const &file,
+        std::size_t offset)
+      : file(file), index(key, file.data() + offset, file.size() - offset)
+  {
+  }
+
+  std::string const input;
+  boost::iostreams::mapped_file_source const file;
+  segments::reader index;
+};
+
+struct container::journal_state
+{
+  journal_state(std::string const &filename, format_type format, boost::uint64_t threshold)
+      : filename(filename), format(format), threshold(threshold)
+  {
+  }
+
+  std::string const filename;
+  format_type const format;
+  boost::uint64_t const threshold;
+  /// \brief Session the store file was last saved with, used for compaction.
+  boost::scoped_ptr< session > keys;
+  boost::scoped_ptr< journal::writer > log;
+};
+
+template < typename T >
+T const &container::storage< T >::get(std::string const &uid) const
+{
+  boost::unordered_map< std::string, std::size_t >::const_iterator it = slots.find(uid);
+  if (it != slots.end())
+  {
+    materialize(it->second);
+    return elements[it->second];
+  }
+  throw invalid_lookup_error();
+}
+
+template < typename T >
+void container::storage< T >::materialize(std::size_t slot) const
+{
+  typename boost::unordered_map< std::size_t, segment >::iterator it = pending.find(slot);
+  if (it != pending.end())
+  {
+    try
+    {
+      T value;
+      source->index.element(it->second, elements[slot], value);
+      std::swap(elements[slot], value);
+    }
+    catch (std::exception const &)
+    {
+      throw corrupted_input_error();
+    }
+    pending.erase(it);
+  }
+}
+
+/// \brief Decryption of pending elements, see container::storage::materialize_all().
+template < typename T >
+struct pending_decryption
+{
+  typedef std::vector< std::pair< std::size_t, segments::extent > > work_type;
+
+  pending_decryption(segments::reader const &index, std::vector< T > const &entries,
+                     work_type const &work, std::vector< T > &values, std::vector< char > &failed)
+      : index(index), entries(entries), work(work), values(values), failed(failed)
+  {
+  }
+
+  void operator()(std::size_t k) const
+  {
+    try
+    {
+      index.element(work[k].second, entries[work[k].first], values[k]);
+    }
+    catch (std::exception const &)
+    {
+      failed[k] = 1;
+    }
+  }
+
+  segments::reader const &index;
+  /// \brief Summaries of the pending elements by position.
+  std::vector< T > const &entries;
+  work_type const &work;
+  std::vector< T > &values;
+  /// \brief Flags of elements which failed, not std::vector< bool > as it is written concurrently.
+  std::vector< char > &failed;
+};
+
+template < typename T >
+void container::storage< T >::materialize_all(std::size_t threads) const
+{
+  if (pending.empty())
+  {
+    return;
+  }
+
+  typename pending_decryption< T >::work_type const work(pending.begin(), pending.end());
+  std::vector< T > values(work.size());
+  std::vector< char > failed(work.size(), 0);
+  auxiliary::parallel_for(threads, work.size(),
+                          pending_decryption< T >(source->index, elements, work, values, failed));
+
+  for (std::size_t k = 0; k < work.size(); ++k)
+  {
+    if (!failed[k])
+    {
+      std::swap(elements[work[k].first], values[k]);
+      pending.erase(work[k].first);
+    }
+  }
+  if (!pending.empty())
+  {
+    throw corrupted_input_error();
+  }
+}
+
+template < typename T >
+std::string container::storage< T >::set(T const &value)
+{
+  if (!value.uid.empty())
+  {
+    boost::unordered_map< std::string, std::size_t >::const_iterator it = slots.find(value.uid);
+    if (it != slots.end())
+    {
+      pending.erase(it->second);
+      if (it->second < records.size())
+      {
+        records[it->second].clear();
+      }
+      unindex(elements[it->second]);
+      elements[it->second] = value;
+      index(elements[it->second]);
+      return value.uid;
+    }
+    throw invalid_lookup_error();
+  }
+  else
+  {
+    boost::uuids::random_generator generate;
+    elements.push_back(value);
+    elements.back().uid = unique_id(generate, slots);
+    slots.insert(std::make_pair(elements.back().uid, elements.size() - 1));
+    index(elements.back());
+    return elements.back().uid;
+  }
+}
+
+template < typename T >
+std::vector< std::string > container::storage< T >::insert(std::vector< T > &values)
+{
+  BOOST_FOREACH (T const &value, values)
+  {
+    if (!value.uid.empty())
+    {
+      throw invalid_lookup_error();
+    }
+  }
+
+  std::size_t const size = elements.size();
+  std::vector< std::string > output;
+  try
+  {
+    output.reserve(values.size());
+    elements.reserve(size + values.size());
+    slots.reserve(size + values.size());
+
+    // One generator for all elements, drawing from the random device of the system like set().
+    boost::uuids::random_generator generate;
+    BOOST_FOREACH (T &value, values)
+    {
+      output.push_back(unique_id(generate, slots));
+      elements.push_back(T());
+      exchange(elements.back(), value);
+      elements.back().uid = output.back();
+      slots.insert(std::make_pair(output.back(), elements.size() - 1));
+      index(elements.back());
+    }
+  }
+  catch (...)
+  {
+    // The search indexes may be half updated, they are rebuilt on demand instead.
+    text.reset();
+    titles.reset();
+    while (elements.size() > size)
+    {
+      unindex(elements.back());
+      slots.erase(elements.back().uid);
+      elements.back().uid.clear();
+      exchange(elements.back(), values[elements.size() - size - 1]);
+      elements.pop_back();
+    }
+    throw;
+  }
+  return output;
+}
+
+template < typename T >
+void container::storage< T >::truncate(std::size_t size)
+{
+  while (elements.size() > size)
+  {
+    unindex(elements.back());
+    slots.erase(elements.back().uid);
+    elements.pop_back();
+  }
+  if (records.size() > size)
+  {
+    records.resize(size);
+  }
+}
+
+template < typename T >
+T const &container::storage< T >::peek(std::size_t slot, T &scratch) const
+{
+  typename boost::unordered_map< std::size_t, segment >::const_iterator it = pending.find(slot);
+  if (it == pending.end())
+  {
+    return elements[slot];
+  }
+
+  try
+  {
+    source->index.element(it->second, elements[slot], scratch);
+  }
+  catch (std::exception const &)
+  {
+    throw corrupted_input_error();
+  }
+  return scratch;
+}
 
-  std::stringstream indata;
-  indata << aes::decrypt(password, input);
+template < typename T >
+std::size_t container::storage< T >::write_csv(std::ostream &output) const
+{
+  csv::writer document(output);
+  serialization::write_header< T >(document);
+  T scratch;
+  for (std::size_t k = 0; k < elements.size(); ++k)
+  {
+    serialization::write(document, peek(k, scratch));
+  }
+  return elements.size();
+}
 
-  pt::ptree tree;
+template < typename T >
+std::size_t container::storage< T >::read_csv(std::streambuf &input)
+{
+  std::size_t const size = elements.size();
   try
   {
-    pt::read_json(indata, tree);
+    csv::reader document(input);
+    std::vector< std::string > row;
+    if (!document.row(row))
+    {
+      return 0;
+    }
+    std::vector< std::size_t > const columns = serialization::columns< T >(row);
+    std::size_t const width = row.size();
+
+    std::vector< T > batch;
+    batch.reserve(import_batch);
+    while (document.row(row))
+    {
+      if (row.size() == 1 && row[0].empty())
+      {
+        continue;
+      }
+      else if (row.size() != width)
+      {
+        throw csv::parse_error();
+      }
+
+      batch.push_back(T());
+      serialization::read(row, columns, batch.back());
+      batch.back().uid.clear();
+      if (batch.size() == import_batch)
+      {
+        insert(batch);
+        batch.clear();
+      }
+    }
+    insert(batch);
+  }
+  catch (std::exception const &)
+  {
+    truncate(size);
+    throw corrupted_input_error();
+  }
+  return elements.size() - size;
+}
+
+template < typename T >
+std::size_t container::storage< T >::write_lines(std::ostream &output, char const *type) const
+{
+  T scratch;
+  for (std::size_t k = 0; k < elements.size(); ++k)
+  {
+    json::writer line(output, json::writer::LAYOUT_LINE);
+    line.begin_object();
+    line.value("type", type);
+    serialization::write_members(line, peek(k, scratch));
+    line.end_object();
+  }
+  return elements.size();
+}
+
+template < typename T >
+void container::storage< T >::read_line(json::reader &input, std::vector< T > &batch)
+{
+  batch.push_back(T());
+  serialization::read_members(input, batch.back());
+  batch.back().uid.clear();
+  if (batch.size() == import_batch)
+  {
+    insert(batch);
+    batch.clear();
+  }
+}
+
+template < typename T >
+void container::storage< T >::restore(T const &value)
+{
+  if (value.uid.empty())
+  {
+    throw invalid_lookup_error();
+  }
+
+  if (slots.find(value.uid) != slots.end())
+  {
+    set(value);
+    return;
+  }
+  elements.push_back(value);
+  slots.insert(std::make_pair(value.uid, elements.size() - 1));
+  index(elements.back());
+}
+
+template < typename T >
+std::vector< std::string > &container::storage< T >::serialized(bool json) const
+{
+  if (records_json != json)
+  {
+    records.clear();
+    records_json = json;
+  }
+  // Elements are only ever appended or replaced in place, new ones get empty entries.
+  records.resize(elements.size());
+  return records;
+}
+
+template < typename T >
+void container::storage< T >::clear()
+{
+  elements.clear();
+  slots.clear();
+  by_category.clear();
+  pending.clear();
+  source.reset();
+  records.clear();
+  text.reset();
+  titles.reset();
+}
+
+template < typename T >
+void container::storage< T >::index(T const &value)
+{
+  by_category[value.category][value.uid] = element_title(value);
+  if (text && !text.unique())
+  {
+    text.reset();
+  }
+  if (text)
+  {
+    text->insert(value.uid, searchable_text(value));
+  }
+  if (titles && !titles.unique())
+  {
+    titles.reset();
+  }
+  if (titles)
+  {
+    titles->insert(value.uid, element_title(value));
+  }
+}
+
+template < typename T >
+void container::storage< T >::unindex(T const &value)
+{
+  if (text && !text.unique())
+  {
+    text.reset();
+  }
+  if (text)
+  {
+    text->erase(value.uid);
+  }
+  if (titles && !titles.unique())
+  {
+    titles.reset();
+  }
+  if (titles)
+  {
+    titles->erase(value.uid);
+  }
 
-    BOOST_FOREACH (pt::ptree::value_type const &value, tree.get_child("logins"))
+  std::map< std::string, std::map< std::string, std::string > >::iterator it =
+      by_category.find(value.category);
+  if (it != by_category.end())
+  {
+    it->second.erase(value.uid);
+    if (it->second.empty())
     {
-      pt::ptree const &subtree = value.second;
-      logins.push_back(login_type());
-      logins.back().load(subtree);
+      by_category.erase(it);
     }
+  }
+}
+
+template < typename T >
+std::set< std::string > container::storage< T >::categories() const
+{
+  std::set< std::string > output;
+  for (std::map< std::string, std::map< std::string, std::string > >::const_iterator it =
+           by_category.begin();
+       it != by_category.end(); ++it)
+  {
+    output.insert(output.end(), it->first);
+  }
+  return output;
+}
+
+template < typename T >
+std::map< std::string, std::string > container::storage< T >::elements_by_category(
+    std::string const &cat) const
+{
+  std::map< std::string, std::map< std::string, std::string > >::const_iterator it =
+      by_category.find(cat);
+  if (it != by_category.end())
+  {
+    return it->second;
+  }
+  return std::map< std::string, std::string >();
+}
+
+static bool accept(element_visitor &visitor, login_type const &value)
+{
+  return visitor.login(value);
+}
 
-    BOOST_FOREACH (pt::ptree::value_type const &value, tree.get_child("notes"))
+static bool accept(element_visitor &visitor, note_type const &value)
+{
+  return visitor.note(value);
+}
+
+static bool accept(element_visitor &visitor, file_type const &value)
+{
+  return visitor.file(value);
+}
+
+static bool accept(element_visitor &visitor, contact_type const &value)
+{
+  return visitor.contact(value);
+}
+
+template < typename T >
+bool container::storage< T >::visit(std::string const *cat, element_visitor &visitor) const
+{
+  // A sequential scan beats looking up the members of the category one by one, and summaries of
+  // pending elements carry their category, so only visited elements are decrypted.
+  T scratch;
+  for (std::size_t k = 0; k < elements.size(); ++k)
+  {
+    if ((!cat || elements[k].category == *cat) && !accept(visitor, peek(k, scratch)))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template < typename T >
+bool container::storage< T >::visit_titles(std::string const &cat, title_visitor &visitor) const
+{
+  std::map< std::string, std::map< std::string, std::string > >::const_iterator it =
+      by_category.find(cat);
+  if (it != by_category.end())
+  {
+    for (std::map< std::string, std::string >::const_iterator entry = it->second.begin();
+         entry != it->second.end(); ++entry)
+    {
+      if (!visitor.title(entry->first, entry->second))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template < typename T >
+std::map< std::string, std::string > container::storage< T >::search(
+    std::string const &query) const
+{
+  if (!text)
+  {
+    materialize_all(auxiliary::thread_count(0));
+    boost::shared_ptr< ::search::index > output(new ::search::index);
+    BOOST_FOREACH (T const &value, elements)
+    {
+      output->insert(value.uid, searchable_text(value));
+    }
+    text = output;
+  }
+
+  std::map< std::string, std::string > output;
+  BOOST_FOREACH (std::string const &uid, text->find(query))
+  {
+    output.insert(output.end(),
+                  std::make_pair(uid, element_title(elements[slots.find(uid)->second])));
+  }
+  return output;
+}
+
+template < typename T >
+std::vector< std::pair< std::string, std::string > > container::storage< T >::titles_by_prefix(
+    std::string const &prefix, std::size_t count, std::string &cursor) const
+{
+  if (!titles)
+  {
+    // Summaries of pending elements carry their titles, so nothing needs to be decrypted.
+    boost::shared_ptr< ::search::prefix_index > output(new ::search::prefix_index);
+    BOOST_FOREACH (T const &value, elements)
+    {
+      output->insert(value.uid, element_title(value));
+    }
+    titles = output;
+  }
+
+  std::vector< std::pair< std::string, std::string > > output;
+  BOOST_FOREACH (std::string const &uid, titles->find(prefix, count, cursor))
+  {
+    output.push_back(std::make_pair(uid, element_title(elements[slots.find(uid)->second])));
+  }
+  return output;
+}
+
+/// \brief Reads visited fields from a property tree, used by the element load() functions.
+struct ptree_field_reader
+{
+  explicit ptree_field_reader(boost::property_tree::ptree const &tree) : tree(tree) {}
+
+  template < typename V >
+  void operator()(char const *name, V &value)
+  {
+    value = tree.get< V >(name);
+  }
+
+  void operator()(char const *name, schema::blob< std::string > value)
+  {
+    value.text = base64::decode(tree.get< std::string >(name));
+  }
+
+  boost::property_tree::ptree const &tree;
+};
+
+/// \brief Writes visited fields to a property tree, used by the element save() functions.
+struct ptree_field_writer
+{
+  template < typename V >
+  void operator()(char const *name, V const &value)
+  {
+    tree.put(name, value);
+  }
+
+  void operator()(char const *name, schema::blob< std::string const > value)
+  {
+    tree.put(name, base64::encode(value.text));
+  }
+
+  boost::property_tree::ptree tree;
+};
+
+/// \brief Reads a vault document in JSON format.
+static void read_document(json::reader &document, std::vector< login_type > &logins,
+                          std::vector< note_type > &notes, std::vector< file_type > &files,
+                          std::vector< contact_type > &contacts)
+{
+  std::string key;
+  unsigned int seen = 0;
+  document.expect('{');
+  if (!document.next('}'))
+  {
+    do
+    {
+      document.string(key);
+      document.expect(':');
+      if (key == "logins" && !(seen & 1))
+      {
+        serialization::read_section(document, logins);
+        seen |= 1;
+      }
+      else if (key == "notes" && !(seen & 2))
+      {
+        serialization::read_section(document, notes);
+        seen |= 2;
+      }
+      else if (key == "files" && !(seen & 4))
+      {
+        serialization::read_section(document, files);
+        seen |= 4;
+      }
+      else if (key == "contacts" && !(seen & 8))
+      {
+        serialization::read_section(document, contacts);
+        seen |= 8;
+      }
+      else
+      {
+        document.skip();
+      }
+    } while (document.next(','));
+    document.expect('}');
+  }
+  document.finish();
+
+  if (seen != 15)
+  {
+    throw corrupted_input_error();
+  }
+}
+
+/// \brief Reads a vault document in binary format.
+static void read_document(binary::reader &document, std::vector< login_type > &logins,
+                          std::vector< note_type > &notes, std::vector< file_type > &files,
+                          std::vector< contact_type > &contacts)
+{
+  if (document.header() > binary::version)
+  {
+    throw corrupted_input_error();
+  }
+  serialization::read_section(document, logins);
+  serialization::read_section(document, notes);
+  serialization::read_section(document, files);
+  serialization::read_section(document, contacts);
+  document.finish();
+}
+
+/// \brief Work factor of sessions without explicit one, calibrated on first use.
+static boost::uint32_t default_iterations()
+{
+  static boost::uint32_t const iterations = aes::calibrate(0.25);
+  return iterations;
+}
+
+element_visitor::~element_visitor() {}
+
+bool element_visitor::login(login_type const &)
+{
+  return true;
+}
+
+bool element_visitor::note(note_type const &)
+{
+  return true;
+}
+
+bool element_visitor::file(file_type const &)
+{
+  return true;
+}
+
+bool element_visitor::contact(contact_type const &)
+{
+  return true;
+}
+
+title_visitor::~title_visitor() {}
+
+session::session(std::string const &password)
+    : password(password), iterations(0), key_iterations(0)
+{
+}
+
+session::session(std::string const &password, boost::uint32_t iterations)
+    : password(password), iterations(iterations), key_iterations(0)
+{
+}
+
+std::string session::seal(unsigned int layout, std::string const &key)
+{
+  if (salt.empty())
+  {
+    envelope::parameters const kdf =
+        envelope::generate_parameters(iterations ? iterations : default_iterations());
+    salt = kdf.salt;
+    iterations = kdf.iterations;
+  }
+
+  envelope::parameters kdf;
+  kdf.salt = salt;
+  kdf.iterations = iterations;
+  return envelope::seal(derive(salt, iterations), kdf,
+                        static_cast< envelope::layout_type >(layout), key);
+}
+
+std::string session::unseal(char const *data, std::size_t size, std::size_t &offset,
+                            unsigned int &layout)
+{
+  offset = 0;
+  layout = envelope::LAYOUT_STREAM;
+  if (!envelope::detect(data, size))
+  {
+    return password;
+  }
+
+  envelope::parameters const kdf = envelope::read_parameters(data, size);
+  envelope::layout_type type = envelope::LAYOUT_STREAM;
+  std::string const output =
+      envelope::open(derive(kdf.salt, kdf.iterations), data, size, type);
+
+  // Adopt the parameters of the store, its key is cached now.
+  salt = kdf.salt;
+  iterations = kdf.iterations;
+  offset = envelope::header_size(data, size);
+  layout = type;
+  return output;
+}
+
+std::string const &session::derive(std::string const &salt, boost::uint32_t iterations)
+{
+  if (key.empty() || salt != key_salt || iterations != key_iterations)
+  {
+    key = aes::derive_key(password, salt, iterations);
+    key_salt = salt;
+    key_iterations = iterations;
+  }
+  return key;
+}
+
+container::container() {}
+
+container::container(container const &other)
+    : logins(other.logins), notes(other.notes), files(other.files), contacts(other.contacts),
+      urls(other.urls)
+{
+}
+
+container &container::operator=(container const &other)
+{
+  if (this != &other)
+  {
+    logins = other.logins;
+    notes = other.notes;
+    files = other.files;
+    contacts = other.contacts;
+    journaling.reset();
+    urls = other.urls;
+  }
+  return *this;
+}
+
+void container::load(std::string const &password, std::string const &input)
+{
+  session keys(password);
+  load(keys, input);
+}
+
+void container::load(session &keys, std::string const &input)
+{
+  std::string key;
+  std::size_t offset = 0;
+  unsigned int layout = envelope::LAYOUT_STREAM;
+  boost::shared_ptr< vault > source;
+  try
+  {
+    key = keys.unseal(input.data(), input.size(), offset, layout);
+    if (layout == envelope::LAYOUT_SEGMENTED)
+    {
+      source.reset(new vault(key, input, offset));
+    }
+  }
+  catch (std::exception const &)
+  {
+    clear();
+    throw corrupted_input_error();
+  }
+
+  if (source)
+  {
+    load(source);
+  }
+  else if (layout == envelope::LAYOUT_CHUNKED)
+  {
+    aes::chunked_decryptor buffer(key, input.data() + offset, input.size() - offset);
+    load(buffer);
+  }
+  else
+  {
+    aes::decryptor buffer(key, input.data() + offset, input.size() - offset);
+    load(buffer);
+  }
+}
+
+void container::load_from_file(std::string const &password, std::string const &filename)
+{
+  session keys(password);
+  load_from_file(keys, filename);
+}
+
+void container::load_from_file(session &keys, std::string const &filename)
+{
+  boost::iostreams::mapped_file_source file;
+  try
+  {
+    // Empty files cannot be mapped, but are no valid store either.
+    if (boost::filesystem::file_size(filename) != 0)
+    {
+      file.open(filename);
+    }
+  }
+  catch (std::exception const &)
+  {
+    throw auxiliary::file_access_error();
+  }
+
+  if (!file.is_open())
+  {
+    load(keys, std::string());
+    return;
+  }
+
+  std::string key;
+  std::size_t offset = 0;
+  unsigned int layout = envelope::LAYOUT_STREAM;
+  boost::shared_ptr< vault > source;
+  try
+  {
+    key = keys.unseal(file.data(), file.size(), offset, layout);
+    if (layout == envelope::LAYOUT_SEGMENTED)
+    {
+      source.reset(new vault(key, file, offset));
+    }
+  }
+  catch (std::exception const &)
+  {
+    clear();
+    throw corrupted_input_error();
+  }
+
+  if (source)
+  {
+    load(source);
+  }
+  else if (layout == envelope::LAYOUT_CHUNKED)
+  {
+    aes::chunked_decryptor buffer(key, file.data() + offset, file.size() - offset);
+    load(buffer);
+  }
+  else
+  {
+    aes::decryptor buffer(key, file.data() + offset, file.size() - offset);
+    load(buffer);
+  }
+
+  try
+  {
+    replay(key, filename);
+  }
+  catch (std::exception const &)
+  {
+    clear();
+    throw corrupted_input_error();
+  }
+}
+
+std::string container::save(std::string const &password, format_type format) const
+{
+  session keys(password);
+  return save(keys, format);
+}
+
+std::string container::save(session &keys, format_type format) const
+{
+  std::string output;
+  auxiliary::output_buffer buffer(output);
+  save(keys, buffer, format);
+  return output;
+}
+
+void container::save_to_file(std::string const &password, std::string const &filename,
+                             format_type format) const
+{
+  session keys(password);
+  save_to_file(keys, filename, format);
+}
+
+void container::save_to_file(session &keys, std::string const &filename,
+                             format_type format) const
+{
+  // Pending elements may be mapped from the very file replaced here.
+  materialize();
+
+  // The file is replaced only once the new one is on disk, a crash leaves either of both.
+  std::string const temporary = filename + ".tmp";
+  try
+  {
+    {
+      auxiliary::file_buffer file(temporary, false);
+      save(keys, file, format);
+      file.commit();
+    }
+    auxiliary::replace_file(temporary, filename);
+
+    // Records of the journal are encrypted with the data key of the previous save.
+    if (journaling && journaling->filename == filename)
+    {
+      restart(*journaling, keys);
+    }
+  }
+  catch (std::exception const &)
+  {
+    boost::system::error_code ignored;
+    boost::filesystem::remove(temporary, ignored);
+    throw auxiliary::file_access_error();
+  }
+}
+
+void container::journal_to_file(session &keys, std::string const &filename, format_type format,
+                                boost::uint64_t threshold)
+{
+  save_to_file(keys, filename, format);
+
+  boost::shared_ptr< journal_state > state(new journal_state(filename, format, threshold));
+  try
+  {
+    restart(*state, keys);
+  }
+  catch (std::exception const &)
+  {
+    throw auxiliary::file_access_error();
+  }
+  journaling = state;
+}
+
+void container::compact()
+{
+  if (journaling)
+  {
+    boost::shared_ptr< journal_state > const state = journaling;
+    save_to_file(*state->keys, state->filename, state->format);
+  }
+}
+
+void container::restart(journal_state &state, session &keys)
+{
+  std::string header(envelope::max_header_size, 0x0);
+  {
+    std::ifstream file(state.filename.c_str(), std::ifstream::binary);
+    file.read(&header[0], header.size());
+    header.resize(static_cast< std::size_t >(file.gcount()));
+  }
+
+  std::size_t offset = 0;
+  unsigned int layout = envelope::LAYOUT_STREAM;
+  std::string const key = keys.unseal(header.data(), header.size(), offset, layout);
+  state.log.reset(new journal::writer(key, journal::path(state.filename)));
+  if (state.keys.get() != &keys)
+  {
+    state.keys.reset(new session(keys));
+  }
+}
+
+template < typename T >
+static T journal_element(journal::reader &log)
+{
+  T value;
+  log.element(value);
+  return value;
+}
+
+void container::replay(std::string const &key, std::string const &filename)
+{
+  journal::reader log(key, journal::path(filename));
+  while (log.next())
+  {
+    if (log.type() == TYPE_LOGIN)
+    {
+      logins.restore(journal_element< login_type >(log));
+    }
+    else if (log.type() == TYPE_NOTE)
+    {
+      notes.restore(journal_element< note_type >(log));
+    }
+    else if (log.type() == TYPE_FILE)
+    {
+      files.restore(journal_element< file_type >(log));
+    }
+    else if (log.type() == TYPE_CONTACT)
+    {
+      contacts.restore(journal_element< contact_type >(log));
+    }
+    else
+    {
+      throw corrupted_input_error();
+    }
+  }
+}
+
+template < typename T >
+void container::record(content_type type, T const &value)
+{
+  if (journaling)
+  {
+    journaling->log->append(type, value);
+    if (journaling->log->size() > journaling->threshold)
+    {
+      compact();
+    }
+  }
+}
+
+template < typename T >
+void container::record(content_type type, storage< T > const &source, std::size_t first)
+{
+  if (journaling)
+  {
+    for (std::size_t k = first; k < source.elements.size(); ++k)
+    {
+      journaling->log->append(type, source.elements[k]);
+    }
+    if (journaling->log->size() > journaling->threshold)
+    {
+      compact();
+    }
+  }
+}
+
+void container::index_urls(std::size_t first)
+{
+  if (urls && !urls.unique())
+  {
+    urls.reset();
+  }
+  try
+  {
+    for (std::size_t k = first; urls && k < logins.elements.size(); ++k)
+    {
+      urls->insert(logins.elements[k].uid, logins.elements[k].url);
+    }
+  }
+  catch (...)
+  {
+    // The logins are stored already, the index is rebuilt on demand instead.
+    urls.reset();
+  }
+}
+
+void container::change_password(std::string const &old_password,
+                                std::string const &new_password, std::string &input)
+{
+  if (envelope::detect(input.data(), input.size()))
+  {
+    try
+    {
+      session current(old_password), next(new_password);
+      std::size_t offset = 0;
+      unsigned int layout = envelope::LAYOUT_STREAM;
+      std::string const key = current.unseal(input.data(), input.size(), offset, layout);
+      input.replace(0, offset, next.seal(layout, key));
+    }
+    catch (std::exception const &)
+    {
+      throw corrupted_input_error();
+    }
+    return;
+  }
+
+  // Stores of earlier versions are migrated in their payload format.
+  container store;
+  store.load(old_password, input);
+
+  aes::decryptor buffer(old_password, input.data(), input.size());
+  input = store.save(new_password, binary::detect(buffer) ? FORMAT_BINARY : FORMAT_JSON);
+}
+
+void container::change_password_of_file(std::string const &old_password,
+                                        std::string const &new_password,
+                                        std::string const &filename)
+{
+  std::ifstream file(filename.c_str(), std::ifstream::binary);
+  if (!file)
+  {
+    throw auxiliary::file_access_error();
+  }
+
+  // Envelope headers are replaced in front of the unchanged payload, anything else is migrated.
+  // Either way the store is written anew and replaces the file atomically.
+  std::string input(envelope::max_header_size, 0x0);
+  file.read(&input[0], input.size());
+  input.resize(static_cast< std::size_t >(file.gcount()));
+
+  bool current = false;
+  try
+  {
+    envelope::header_size(input.data(), input.size());
+    current = true;
+  }
+  catch (std::exception const &)
+  {
+  }
+
+  if (!current)
+  {
+    file.close();
+    boost::iostreams::mapped_file_source mapping;
+    try
+    {
+      if (boost::filesystem::file_size(filename) != 0)
+      {
+        mapping.open(filename);
+        input.assign(mapping.data(), mapping.size());
+      }
+    }
+    catch (std::exception const &)
+    {
+      throw auxiliary::file_access_error();
+    }
+  }
+  change_password(old_password, new_password, input);
+
+  std::string const temporary = filename + ".tmp";
+  try
+  {
+    {
+      auxiliary::file_buffer output(temporary, false);
+      output.sputn(input.data(), input.size());
+      if (current)
+      {
+        std::vector< char > buffer(1 << 16);
+        while (file.read(&buffer[0], buffer.size()) || file.gcount())
+        {
+          output.sputn(&buffer[0], file.gcount());
+        }
+        if (!file.eof())
+        {
+          throw auxiliary::file_access_error();
+        }
+        file.close();
+      }
+      output.commit();
+    }
+    auxiliary::replace_file(temporary, filename);
+  }
+  catch (std::exception const &)
+  {
+    boost::system::error_code ignored;
+    boost::filesystem::remove(temporary, ignored);
+    throw auxiliary::file_access_error();
+  }
+}
+
+void container::load(std::streambuf &input)
+{
+  clear();
+
+  try
+  {
+    if (binary::detect(input))
+    {
+      binary::reader document(input);
+      read_document(document, logins.elements, notes.elements, files.elements,
+                    contacts.elements);
+    }
+    else
+    {
+      json::reader document(input);
+      read_document(document, logins.elements, notes.elements, files.elements,
+                    contacts.elements);
+    }
+  }
+  catch (std::exception const &)
+  {
+    clear();
+    throw corrupted_input_error();
+  }
+
+  logins.rebuild();
+  notes.rebuild();
+  files.rebuild();
+  contacts.rebuild();
+}
+
+void container::load(boost::shared_ptr< vault > const &source)
+{
+  clear();
+
+  try
+  {
+    std::vector< segment > extents;
+    source->index.section(logins.elements, extents);
+    for (std::size_t k = 0; k < extents.size(); ++k)
+    {
+      logins.pending[k] = extents[k];
+    }
+    extents.clear();
+    source->index.section(notes.elements, extents);
+    for (std::size_t k = 0; k < extents.size(); ++k)
     {
-      pt::ptree const &subtree = value.second;
-      notes.push_back(note_type());
-      notes.back().load(subtree);
+      notes.pending[k] = extents[k];
     }
-
-    BOOST_FOREACH (pt::ptree::value_type const &value, tree.get_child("files"))
+    extents.clear();
+    source->index.section(files.elements, extents);
+    for (std::size_t k = 0; k < extents.size(); ++k)
     {
-      pt::ptree const &subtree = value.second;
-      files.push_back(file_type());
-      files.back().load(subtree);
+      files.pending[k] = extents[k];
     }
-
-    BOOST_FOREACH (pt::ptree::value_type const &value, tree.get_child("contacts"))
+    extents.clear();
+    source->index.section(contacts.elements, extents);
+    for (std::size_t k = 0; k < extents.size(); ++k)
     {
-      pt::ptree const &subtree = value.second;
-      contacts.push_back(contact_type());
-      contacts.back().load(subtree);
+      contacts.pending[k] = extents[k];
     }
+    source->index.finish();
   }
   catch (std::exception const &)
   {
+    clear();
     throw corrupted_input_error();
   }
+
+  logins.source = notes.source = files.source = contacts.source = source;
+  logins.rebuild();
+  notes.rebuild();
+  files.rebuild();
+  contacts.rebuild();
 }
 
-void container::load_from_file(std::string const &password, std::string const &filename)
+void container::save(session &keys, std::streambuf &output, format_type format) const
 {
-  std::ifstream file(filename.c_str(), std::ifstream::binary);
-  if (file)
+  boost::lock_guard< boost::mutex > lock(saving);
+  materialize();
+
+  std::string const key = envelope::generate_key();
+  std::string const header =
+      keys.seal(format == FORMAT_SEGMENTED ? envelope::LAYOUT_SEGMENTED : envelope::LAYOUT_CHUNKED,
+                key);
+  if (output.sputn(header.data(), header.size()) != static_cast< std::streamsize >(header.size()))
   {
-    file.seekg(0, std::ifstream::end);
-    std::size_t const file_size = static_cast< std::size_t >(file.tellg());
-    file.seekg(0, std::ifstream::beg);
+    throw auxiliary::file_access_error();
+  }
 
-    std::string file_content(file_size, 0x0);
-    file.read(&file_content[0], file_content.size());
-    file.close();
+  if (format == FORMAT_SEGMENTED)
+  {
+    segments::writer document(key, output);
+    document.section(logins.elements, logins.serialized(false));
+    document.section(notes.elements, notes.serialized(false));
+    document.section(files.elements, files.serialized(false));
+    document.section(contacts.elements, contacts.serialized(false));
+    document.finish();
+    return;
+  }
 
-    load(password, file_content);
+  aes::chunked_encryptor buffer(key, output);
+  std::ostream stream(&buffer);
+  stream.exceptions(std::ostream::failbit | std::ostream::badbit);
+  if (format == FORMAT_BINARY)
+  {
+    binary::writer document(stream);
+    document.header();
+    serialization::write_section(document, logins.elements, logins.serialized(false));
+    serialization::write_section(document, notes.elements, notes.serialized(false));
+    serialization::write_section(document, files.elements, files.serialized(false));
+    serialization::write_section(document, contacts.elements, contacts.serialized(false));
   }
   else
   {
-    throw auxiliary::file_access_error();
+    json::writer document(stream);
+    document.begin_object();
+    serialization::write_section(document, "logins", logins.elements, logins.serialized(true));
+    serialization::write_section(document, "notes", notes.elements, notes.serialized(true));
+    serialization::write_section(document, "files", files.elements, files.serialized(true));
+    serialization::write_section(document, "contacts", contacts.elements,
+                                 contacts.serialized(true));
+    document.end_object();
   }
+  stream.flush();
+  buffer.finish();
 }
 
-std::string container::save(std::string const &password) const
+void container::materialize(std::size_t threads) const
 {
-  namespace pt = boost::property_tree;
+  threads = auxiliary::thread_count(threads);
+  logins.materialize_all(threads);
+  notes.materialize_all(threads);
+  files.materialize_all(threads);
+  contacts.materialize_all(threads);
+}
 
-  pt::ptree tree;
+void container::clear()
+{
+  logins.clear();
+  notes.clear();
+  files.clear();
+  contacts.clear();
+  journaling.reset();
+  urls.reset();
+}
 
-  pt::ptree logins_child;
-  BOOST_FOREACH (login_type const &value, logins)
+std::set< std::string > container::categories(content_type t) const
+{
+  if (t == TYPE_LOGIN)
   {
-    logins_child.push_back(std::make_pair("", value.save()));
+    return logins.categories();
   }
-  tree.add_child("logins", logins_child);
-
-  pt::ptree notes_child;
-  BOOST_FOREACH (note_type const &value, notes)
+  else if (t == TYPE_NOTE)
   {
-    notes_child.push_back(std::make_pair("", value.save()));
+    return notes.categories();
   }
-  tree.add_child("notes", notes_child);
-
-  pt::ptree files_child;
-  BOOST_FOREACH (file_type const &value, files)
+  else if (t == TYPE_FILE)
   {
-    files_child.push_back(std::make_pair("", value.save()));
+    return files.categories();
   }
-  tree.add_child("files", files_child);
-
-  pt::ptree contacts_child;
-  BOOST_FOREACH (contact_type const &value, contacts)
+  else if (t == TYPE_CONTACT)
   {
-    contacts_child.push_back(std::make_pair("", value.save()));
+    return contacts.categories();
   }
-  tree.add_child("contacts", contacts_child);
-
-  std::stringstream outdata;
-  pt::write_json(outdata, tree);
-  return aes::encrypt(password, outdata.str());
+  throw invalid_lookup_error();
 }
 
-void container::save_to_file(std::string const &password, std::string const &filename) const
+std::map< std::string, std::string > container::elements_by_category(content_type t,
+                                                                     std::string const &cat) const
 {
-  std::ofstream file(filename.c_str(), std::ofstream::binary);
-  if (file)
+  if (t == TYPE_LOGIN)
   {
-    std::string const file_content = save(password);
-    file.write(file_content.c_str(), file_content.size());
-    file.close();
+    return logins.elements_by_category(cat);
   }
-  else
+  else if (t == TYPE_NOTE)
   {
-    throw auxiliary::file_access_error();
+    return notes.elements_by_category(cat);
+  }
+  else if (t == TYPE_FILE)
+  {
+    return files.elements_by_category(cat);
   }
+  else if (t == TYPE_CONTACT)
+  {
+    return contacts.elements_by_category(cat);
+  }
+  throw invalid_lookup_error();
 }
 
-void container::clear()
+bool container::visit(content_type t, element_visitor &visitor) const
 {
-  logins.clear();
-  notes.clear();
-  files.clear();
-  contacts.clear();
+  if (t == TYPE_LOGIN)
+  {
+    return logins.visit(0, visitor);
+  }
+  else if (t == TYPE_NOTE)
+  {
+    return notes.visit(0, visitor);
+  }
+  else if (t == TYPE_FILE)
+  {
+    return files.visit(0, visitor);
+  }
+  else if (t == TYPE_CONTACT)
+  {
+    return contacts.visit(0, visitor);
+  }
+  throw invalid_lookup_error();
 }
 
-std::set< std::string > container::categories(content_type t) const
+bool container::visit(content_type t, std::string const &cat, element_visitor &visitor) const
 {
-  std::set< std::string > output;
   if (t == TYPE_LOGIN)
   {
-    BOOST_FOREACH (login_type const &value, logins)
-    {
-      output.insert(value.category);
-    }
-    return output;
+    return logins.visit(&cat, visitor);
   }
   else if (t == TYPE_NOTE)
   {
-    BOOST_FOREACH (note_type const &value, notes)
-    {
-      output.insert(value.category);
-    }
-    return output;
+    return notes.visit(&cat, visitor);
   }
   else if (t == TYPE_FILE)
   {
-    BOOST_FOREACH (file_type const &value, files)
-    {
-      output.insert(value.category);
-    }
-    return output;
+    return files.visit(&cat, visitor);
   }
   else if (t == TYPE_CONTACT)
   {
-    BOOST_FOREACH (contact_type const &value, contacts)
-    {
-      output.insert(value.category);
-    }
-    return output;
+    return contacts.visit(&cat, visitor);
   }
   throw invalid_lookup_error();
 }
 
-std::map< std::string, std::string > container::elements_by_category(content_type t,
-                                                                     std::string const &cat) const
+bool container::visit_titles(content_type t, std::string const &cat,
+                             title_visitor &visitor) const
 {
-  std::map< std::string, std::string > output;
   if (t == TYPE_LOGIN)
   {
-    BOOST_FOREACH (login_type const &value, logins)
-    {
-      if (value.category == cat)
-      {
-        output.insert(std::make_pair(value.uid, value.title));
-      }
-    }
-    return output;
+    return logins.visit_titles(cat, visitor);
   }
   else if (t == TYPE_NOTE)
   {
-    BOOST_FOREACH (note_type const &value, notes)
-    {
-      if (value.category == cat)
-      {
-        output.insert(std::make_pair(value.uid, value.title));
-      }
-    }
-    return output;
+    return notes.visit_titles(cat, visitor);
   }
   else if (t == TYPE_FILE)
   {
-    BOOST_FOREACH (file_type const &value, files)
-    {
-      if (value.category == cat)
-      {
-        output.insert(std::make_pair(value.uid, value.title));
-      }
-    }
-    return output;
+    return files.visit_titles(cat, visitor);
   }
   else if (t == TYPE_CONTACT)
   {
-    BOOST_FOREACH (contact_type const &value, contacts)
-    {
-      if (value.category == cat)
-      {
-        output.insert(std::make_pair(value.uid, value.title()));
-      }
-    }
-    return output;
+    return contacts.visit_titles(cat, visitor);
   }
   throw invalid_lookup_error();
 }
 
-login_type const &container::login(std::string const &uid) const
+std::map< std::string, std::string > container::search(content_type t,
+                                                       std::string const &query) const
 {
-  BOOST_FOREACH (login_type const &value, logins)
+  if (t == TYPE_LOGIN)
   {
-    if (value.uid == uid)
-    {
-      return value;
-    }
+    return logins.search(query);
+  }
+  else if (t == TYPE_NOTE)
+  {
+    return notes.search(query);
+  }
+  else if (t == TYPE_FILE)
+  {
+    return files.search(query);
+  }
+  else if (t == TYPE_CONTACT)
+  {
+    return contacts.search(query);
   }
   throw invalid_lookup_error();
 }
 
-note_type const &container::note(std::string const &uid) const
+std::vector< std::pair< std::string, std::string > > container::titles_by_prefix(
+    content_type t, std::string const &prefix, std::size_t count, std::string &cursor) const
 {
-  BOOST_FOREACH (note_type const &value, notes)
+  if (t == TYPE_LOGIN)
   {
-    if (value.uid == uid)
-    {
-      return value;
-    }
+    return logins.titles_by_prefix(prefix, count, cursor);
+  }
+  else if (t == TYPE_NOTE)
+  {
+    return notes.titles_by_prefix(prefix, count, cursor);
+  }
+  else if (t == TYPE_FILE)
+  {
+    return files.titles_by_prefix(prefix, count, cursor);
+  }
+  else if (t == TYPE_CONTACT)
+  {
+    return contacts.titles_by_prefix(prefix, count, cursor);
   }
   throw invalid_lookup_error();
 }
 
-file_type const &container::file(std::string const &uid) const
+std::map< std::string, std::string > container::logins_by_url(std::string const &url,
+                                                              match_type match) const
 {
-  BOOST_FOREACH (file_type const &value, files)
+  if (!urls)
   {
-    if (value.uid == uid)
+    logins.materialize_all(auxiliary::thread_count(0));
+    boost::shared_ptr< ::autofill::index > output(new ::autofill::index);
+    BOOST_FOREACH (login_type const &value, logins.elements)
     {
-      return value;
+      output->insert(value.uid, value.url);
     }
+    urls = output;
   }
-  throw invalid_lookup_error();
+
+  std::map< std::string, std::string > output;
+  BOOST_FOREACH (std::string const &uid,
+                 urls->find(url, static_cast< ::autofill::match_type >(match)))
+  {
+    output[uid] = logins.get(uid).title;
+  }
+  return output;
+}
+
+login_type const &container::login(std::string const &uid) const
+{
+  return logins.get(uid);
+}
+
+note_type const &container::note(std::string const &uid) const
+{
+  return notes.get(uid);
+}
+
+file_type const &container::file(std::string const &uid) const
+{
+  return files.get(uid);
 }
 
 contact_type const &container::contact(std::string const &uid) const
 {
-  BOOST_FOREACH (contact_type const &value, contacts)
-  {
-    if (value.uid == uid)
-    {
-      return value;
-    }
-  }
-  throw invalid_lookup_error();
+  return contacts.get(uid);
 }
 
 std::string container::login(login_type const &value)
 {
-  if (!value.uid.empty())
+  std::string const uid = logins.set(value);
+  if (urls && !urls.unique())
   {
-    BOOST_FOREACH (login_type &other, logins)
-    {
-      if (value.uid == other.uid)
-      {
-        other = value;
-        return value.uid;
-      }
-    }
-    throw invalid_lookup_error();
+    urls.reset();
   }
-  else
+  if (urls)
   {
-    logins.push_back(value);
-    boost::uuids::uuid uuid = boost::uuids::uuid(boost::uuids::random_generator()());
-    logins.back().uid = boost::lexical_cast< std::string >(uuid);
-    return logins.back().uid;
+    urls->insert(uid, value.url);
   }
+  record(TYPE_LOGIN, logins.get(uid));
+  return uid;
 }
 
 std::string container::note(note_type const &value)
 {
-  if (!value.uid.empty())
+  std::string const uid = notes.set(value);
+  record(TYPE_NOTE, notes.get(uid));
+  return uid;
+}
+
+std::string container::file(file_type const &value)
+{
+  std::string const uid = files.set(value);
+  record(TYPE_FILE, files.get(uid));
+  return uid;
+}
+
+std::string container::contact(contact_type const &value)
+{
+  std::string const uid = contacts.set(value);
+  record(TYPE_CONTACT, contacts.get(uid));
+  return uid;
+}
+
+std::vector< std::string > container::insert(std::vector< login_type > &values)
+{
+  std::vector< std::string > const uids = logins.insert(values);
+  index_urls(logins.elements.size() - uids.size());
+  record(TYPE_LOGIN, logins, logins.elements.size() - uids.size());
+  return uids;
+}
+
+std::vector< std::string > container::insert(std::vector< note_type > &values)
+{
+  std::vector< std::string > const uids = notes.insert(values);
+  record(TYPE_NOTE, notes, notes.elements.size() - uids.size());
+  return uids;
+}
+
+std::vector< std::string > container::insert(std::vector< file_type > &values)
+{
+  std::vector< std::string > const uids = files.insert(values);
+  record(TYPE_FILE, files, files.elements.size() - uids.size());
+  return uids;
+}
+
+std::vector< std::string > container::insert(std::vector< contact_type > &values)
+{
+  std::vector< std::string > const uids = contacts.insert(values);
+  record(TYPE_CONTACT, contacts, contacts.elements.size() - uids.size());
+  return uids;
+}
+
+std::size_t container::export_csv(content_type t, std::ostream &output) const
+{
+  if (t == TYPE_LOGIN)
   {
-    BOOST_FOREACH (note_type &other, notes)
-    {
-      if (value.uid == other.uid)
-      {
-        other = value;
-        return value.uid;
-      }
-    }
-    throw invalid_lookup_error();
+    return logins.write_csv(output);
   }
-  else
+  else if (t == TYPE_NOTE)
+  {
+    return notes.write_csv(output);
+  }
+  else if (t == TYPE_FILE)
+  {
+    return files.write_csv(output);
+  }
+  else if (t == TYPE_CONTACT)
   {
-    notes.push_back(value);
-    boost::uuids::uuid uuid = boost::uuids::uuid(boost::uuids::random_generator()());
-    notes.back().uid = boost::lexical_cast< std::string >(uuid);
-    return notes.back().uid;
+    return contacts.write_csv(output);
   }
+  throw invalid_lookup_error();
 }
 
-std::string container::file(file_type const &value)
+std::size_t container::import_csv(content_type t, std::istream &input)
 {
-  if (!value.uid.empty())
+  if (t == TYPE_LOGIN)
   {
-    BOOST_FOREACH (file_type &other, files)
-    {
-      if (value.uid == other.uid)
-      {
-        other = value;
-        return value.uid;
-      }
-    }
-    throw invalid_lookup_error();
+    std::size_t const first = logins.elements.size();
+    logins.read_csv(*input.rdbuf());
+    index_urls(first);
+    record(TYPE_LOGIN, logins, first);
+    return logins.elements.size() - first;
   }
-  else
+  else if (t == TYPE_NOTE)
   {
-    files.push_back(value);
-    boost::uuids::uuid uuid = boost::uuids::uuid(boost::uuids::random_generator()());
-    files.back().uid = boost::lexical_cast< std::string >(uuid);
-    return files.back().uid;
+    std::size_t const first = notes.elements.size();
+    notes.read_csv(*input.rdbuf());
+    record(TYPE_NOTE, notes, first);
+    return notes.elements.size() - first;
   }
+  else if (t == TYPE_FILE)
+  {
+    std::size_t const first = files.elements.size();
+    files.read_csv(*input.rdbuf());
+    record(TYPE_FILE, files, first);
+    return files.elements.size() - first;
+  }
+  else if (t == TYPE_CONTACT)
+  {
+    std::size_t const first = contacts.elements.size();
+    contacts.read_csv(*input.rdbuf());
+    record(TYPE_CONTACT, contacts, first);
+    return contacts.elements.size() - first;
+  }
+  throw invalid_lookup_error();
 }
 
-std::string container::contact(contact_type const &value)
+std::size_t container::export_json_lines(std::ostream &output) const
 {
-  if (!value.uid.empty())
+  return logins.write_lines(output, "login") + notes.write_lines(output, "note") +
+         files.write_lines(output, "file") + contacts.write_lines(output, "contact");
+}
+
+std::size_t container::import_json_lines(std::istream &input)
+{
+  std::size_t const first[] = {logins.elements.size(), notes.elements.size(),
+                               files.elements.size(), contacts.elements.size()};
+  try
   {
-    BOOST_FOREACH (contact_type &other, contacts)
+    std::vector< login_type > new_logins;
+    std::vector< note_type > new_notes;
+    std::vector< file_type > new_files;
+    std::vector< contact_type > new_contacts;
+    json::reader document(*input.rdbuf());
+    std::string key;
+    while (!document.done())
     {
-      if (value.uid == other.uid)
+      document.expect('{');
+      document.string(key);
+      document.expect(':');
+      if (key != "type")
+      {
+        throw corrupted_input_error();
+      }
+
+      document.string(key);
+      if (key == "login")
+      {
+        logins.read_line(document, new_logins);
+      }
+      else if (key == "note")
+      {
+        notes.read_line(document, new_notes);
+      }
+      else if (key == "file")
+      {
+        files.read_line(document, new_files);
+      }
+      else if (key == "contact")
+      {
+        contacts.read_line(document, new_contacts);
+      }
+      else
       {
-        other = value;
-        return value.uid;
+        throw corrupted_input_error();
       }
     }
-    throw invalid_lookup_error();
+    logins.insert(new_logins);
+    notes.insert(new_notes);
+    files.insert(new_files);
+    contacts.insert(new_contacts);
   }
-  else
+  catch (std::exception const &)
   {
-    contacts.push_back(value);
-    boost::uuids::uuid uuid = boost::uuids::uuid(boost::uuids::random_generator()());
-    contacts.back().uid = boost::lexical_cast< std::string >(uuid);
-    return contacts.back().uid;
+    logins.truncate(first[0]);
+    notes.truncate(first[1]);
+    files.truncate(first[2]);
+    contacts.truncate(first[3]);
+    throw corrupted_input_error();
   }
+
+  index_urls(first[0]);
+  record(TYPE_LOGIN, logins, first[0]);
+  record(TYPE_NOTE, notes, first[1]);
+  record(TYPE_FILE, files, first[2]);
+  record(TYPE_CONTACT, contacts, first[3]);
+  return logins.elements.size() - first[0] + notes.elements.size() - first[1] +
+         files.elements.size() - first[2] + contacts.elements.size() - first[3];
 }
 
 void login_type::load(boost::property_tree::ptree const &tree)
 {
-  uid = tree.get< std::string >("uid");
-  title = tree.get< std::string >("title");
-  category = tree.get< std::string >("category");
-  username = tree.get< std::string >("username");
-  password = tree.get< std::string >("password");
-  url = tree.get< std::string >("url");
-  last_change = tree.get< boost::posix_time::ptime >("last_change");
+  ptree_field_reader field(tree);
+  schema::visit(*this, field);
 }
 
 boost::property_tree::ptree login_type::save() const
 {
-  boost::property_tree::ptree tree;
-  tree.put("uid", uid);
-  tree.put("title", title);
-  tree.put("category", category);
-  tree.put("username", username);
-  tree.put("password", password);
-  tree.put("url", url);
-  tree.put("last_change", last_change);
-  return tree;
+  ptree_field_writer field;
+  schema::visit(*this, field);
+  return field.tree;
 }
 
 void login_type::generate_password(std::size_t length, std::string const &special_characters)
@@ -419,40 +1886,57 @@ void login_type::generate_password(std::size_t length, std::string const &specia
   last_change = boost::posix_time::second_clock::local_time();
 }
 
+std::vector< std::string > login_type::generate_passwords(std::size_t count, std::size_t length,
+                                                          std::string const &special_characters)
+{
+  return auxiliary::generate_passwords(count, length, special_characters);
+}
+
 void note_type::load(boost::property_tree::ptree const &tree)
 {
-  uid = tree.get< std::string >("uid");
-  title = tree.get< std::string >("title");
-  category = tree.get< std::string >("category");
-  content = tree.get< std::string >("content");
+  ptree_field_reader field(tree);
+  schema::visit(*this, field);
 }
 
 boost::property_tree::ptree note_type::save() const
 {
-  boost::property_tree::ptree tree;
-  tree.put("uid", uid);
-  tree.put("title", title);
-  tree.put("category", category);
-  tree.put("content", content);
-  return tree;
+  ptree_field_writer field;
+  schema::visit(*this, field);
+  return field.tree;
 }
 
 void file_type::load(boost::property_tree::ptree const &tree)
 {
-  uid = tree.get< std::string >("uid");
-  title = tree.get< std::string >("title");
-  category = tree.get< std::string >("category");
-  content = tree.get< std::string >("content");
+  ptree_field_reader field(tree);
+  schema::visit(*this, field);
 }
 
 boost::property_tree::ptree file_type::save() const
 {
-  boost::property_tree::ptree tree;
-  tree.put("uid", uid);
-  tree.put("title", title);
-  tree.put("category", category);
-  tree.put("content", content);
-  return tree;
+  ptree_field_writer field;
+  schema::visit(*this, field);
+  return field.tree;
+}
+
+/// \brief Append a stream to `output` until its end, reading at most one chunk at a time.
+static void read_chunked(std::istream &input, std::string &output)
+{
+  std::size_t const chunk_size = 1 << 20;
+
+  // Fill reserved capacity exactly, so a correct size hint never causes a reallocation.
+  while (input.peek() != std::istream::traits_type::eof())
+  {
+    std::size_t const offset = output.size();
+    std::size_t const spare = output.capacity() - offset;
+    std::size_t const size = spare ? std::min(spare, chunk_size) : chunk_size;
+    output.resize(offset + size);
+    input.read(&output[offset], size);
+    output.resize(offset + static_cast< std::size_t >(input.gcount()));
+  }
+  if (input.bad())
+  {
+    throw auxiliary::file_access_error();
+  }
 }
 
 void file_type::upload(std::string const &filename, bool secure_erase, std::size_t iterations)
@@ -460,15 +1944,19 @@ void file_type::upload(std::string const &filename, bool secure_erase, std::size
   std::ifstream file(filename.c_str(), std::ifstream::binary);
   if (file)
   {
-    file.seekg(0, std::ifstream::end);
-    std::size_t const file_size = static_cast< std::size_t >(file.tellg());
-    file.seekg(0, std::ifstream::beg);
+    // The size is only a hint to avoid reallocations, the file is read until its actual end.
+    std::string file_content;
+    boost::system::error_code error;
+    boost::uintmax_t const file_size = boost::filesystem::file_size(filename, error);
+    if (!error && file_size <= file_content.max_size())
+    {
+      file_content.reserve(static_cast< std::size_t >(file_size));
+    }
 
-    std::string file_content(file_size, 0x0);
-    file.read(&file_content[0], file_content.size());
+    read_chunked(file, file_content);
     file.close();
 
-    content = base64::encode(file_content);
+    content.swap(file_content);
 
     if (secure_erase)
     {
@@ -481,12 +1969,28 @@ void file_type::upload(std::string const &filename, bool secure_erase, std::size
   }
 }
 
-std::string file_type::map()
+void file_type::upload(std::istream &input)
+{
+  std::string stream_content;
+  read_chunked(input, stream_content);
+  content.swap(stream_content);
+}
+
+std::string file_type::encoded_content() const
+{
+  return base64::encode(content);
+}
+
+void file_type::encoded_content(std::string const &encoded)
+{
+  content = base64::decode(encoded);
+}
+
+std::string file_type::map(bool in_memory)
 {
   if (mapped_file.empty())
   {
-    std::string const file_content = base64::decode(content);
-    mapped_file = auxiliary::map_file(file_content);
+    mapped_file = auxiliary::map_file(content, in_memory);
   }
   return mapped_file;
 }
@@ -495,41 +1999,22 @@ void file_type::unmap(std::size_t iterations)
 {
   if (!mapped_file.empty())
   {
-    auxiliary::secure_erase(mapped_file, iterations);
+    auxiliary::unmap_file(mapped_file, iterations);
     mapped_file = "";
   }
 }
 
 void contact_type::load(boost::property_tree::ptree const &tree)
 {
-  uid = tree.get< std::string >("uid");
-  category = tree.get< std::string >("category");
-  first_name = tree.get< std::string >("first_name");
-  last_name = tree.get< std::string >("last_name");
-  email = tree.get< std::string >("email");
-  phone = tree.get< std::string >("phone");
-  street = tree.get< std::string >("street");
-  zip = tree.get< std::string >("zip");
-  city = tree.get< std::string >("city");
-  country = tree.get< std::string >("country");
-  comment = tree.get< std::string >("comment");
+  ptree_field_reader field(tree);
+  schema::visit(*this, field);
 }
 
 boost::property_tree::ptree contact_type::save() const
 {
-  boost::property_tree::ptree tree;
-  tree.put("uid", uid);
-  tree.put("category", category);
-  tree.put("first_name", first_name);
-  tree.put("last_name", last_name);
-  tree.put("email", email);
-  tree.put("phone", phone);
-  tree.put("street", street);
-  tree.put("zip", zip);
-  tree.put("city", city);
-  tree.put("country", country);
-  tree.put("comment", comment);
-  return tree;
+  ptree_field_writer field;
+  schema::visit(*this, field);
+  return field.tree;
 }
 
 std::string contact_type::title() const
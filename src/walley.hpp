@@ -7,12 +7,35 @@
 
 #include <boost/property_tree/ptree.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
+#include <streambuf>
+#include <istream>
+#include <ostream>
 #include <stdexcept>
 
+namespace search
+{
+class index;
+class prefix_index;
+}
+
+namespace autofill
+{
+class index;
+}
+
+namespace json
+{
+class reader;
+}
+
 namespace walley
 {
 struct login_type;
@@ -20,6 +43,97 @@ struct note_type;
 struct file_type;
 struct contact_type;
 
+/// \class session walley.hpp walley.hpp
+/// \brief Master password together with the key derived from it.
+///
+/// The key protecting a store is derived from its master password with PBKDF2, which is slow on
+/// purpose. A session caches the derived key, so any number of load() and save() calls pay the
+/// derivation only once. New sessions use a work factor calibrated once per process to take about
+/// a quarter of a second. Loading a store adopts its salt and work factor, so saving it again
+/// reuses the key derived for loading.
+class session
+{
+public:
+  /// \brief Session with a calibrated work factor, see aes::calibrate().
+  ///
+  /// \param[in] password Master password for stores
+  explicit session(std::string const &password);
+
+  /// \brief Session with an explicit work factor.
+  ///
+  /// Saving throws an exception for work factors above 16777216, which stores are not loaded with.
+  /// A work factor of 0 selects the calibrated one.
+  ///
+  /// \param[in] password Master password for stores
+  /// \param[in] iterations Number of PBKDF2 iterations
+  session(std::string const &password, boost::uint32_t iterations);
+
+private:
+  friend struct container;
+
+  /// \brief Header wrapping a data key, see envelope::seal().
+  ///
+  /// \param[in] layout Layout of the payload, an envelope::layout_type
+  /// \param[in] key Data key the payload is encrypted with
+  /// \return Header
+  std::string seal(unsigned int layout, std::string const &key);
+  /// \brief Key and layout of the payload of a saved store.
+  ///
+  /// Stores of earlier versions have no header, their payload is encrypted with the password.
+  ///
+  /// \param[in] data Beginning of store
+  /// \param[in] size Size of store
+  /// \param[out] offset Position of the payload
+  /// \param[out] layout Layout of the payload, an envelope::layout_type
+  /// \return Key the payload is encrypted with
+  std::string unseal(char const *data, std::size_t size, std::size_t &offset,
+                     unsigned int &layout);
+  /// \brief Derive the key for given parameters, unless it is cached already.
+  std::string const &derive(std::string const &salt, boost::uint32_t iterations);
+
+  std::string const password;
+  /// \brief Key derivation parameters for saving, generated on first use if empty.
+  std::string salt;
+  boost::uint32_t iterations;
+  /// \brief Cached key together with the parameters it was derived with.
+  std::string key;
+  std::string key_salt;
+  boost::uint32_t key_iterations;
+};
+
+/// \class element_visitor walley.hpp walley.hpp
+/// \brief Read-only pass over stored elements, see container::visit().
+///
+/// Override the functions of the content types of interest, the others skip all elements. Elements
+/// are passed by reference and only valid for the duration of the call.
+class element_visitor
+{
+public:
+  virtual ~element_visitor();
+
+  /// \brief Visit a login, return false to stop the pass.
+  virtual bool login(login_type const &value);
+  /// \brief Visit a note, return false to stop the pass.
+  virtual bool note(note_type const &value);
+  /// \brief Visit a file, return false to stop the pass.
+  virtual bool file(file_type const &value);
+  /// \brief Visit a contact, return false to stop the pass.
+  virtual bool contact(contact_type const &value);
+};
+
+/// \class title_visitor walley.hpp walley.hpp
+/// \brief Read-only pass over unique ids and titles, see container::visit_titles().
+class title_visitor
+{
+public:
+  virtual ~title_visitor();
+
+  /// \brief Visit an element by unique id and title, return false to stop the pass.
+  ///
+  /// Both are only valid for the duration of the call.
+  virtual bool title(std::string const &uid, std::string const &title) = 0;
+};
+
 /// \class container walley.hpp walley.hpp
 /// \brief Password store manager.
 ///
@@ -33,12 +147,31 @@ struct contact_type;
 /// strong master password.
 struct container
 {
+  /// \brief Empty store.
+  container();
+
+  /// \brief Copy a store.
+  ///
+  /// The copy is not in journal mode, its changes are never recorded in the journal of `other`.
+  ///
+  /// \param[in] other Store to be copied
+  container(container const &other);
+
+  /// \brief Replace the contents of this store by a copy of another.
+  ///
+  /// Ends journal mode of this store, like the copy constructor the copy is never in journal mode.
+  ///
+  /// \param[in] other Store to be copied
+  /// \return This store
+  container &operator=(container const &other);
+
   /// \brief Load store from memory.
   ///
   /// Given that the contents of a store are already located in memory, this functions can be used
   /// for decryption and subsequent data access. An exception is thrown if the password is invalid,
   /// or the data is not of valid format after decryption. It is not possible to tell whether the
-  /// file is actually a valid password store without the correct password.
+  /// file is actually a valid password store without the correct password. The serialization
+  /// format of the payload is detected automatically, see format_type.
   ///
   /// \param[in] password Master password for store
   /// \param[in] input Saved store from memory
@@ -47,10 +180,21 @@ struct container
   /// \see save()
   void load(std::string const &password, std::string const &input);
 
+  /// \brief Load store from memory, deriving the key with a session.
+  ///
+  /// Like load(std::string const &, std::string const &), but the key derived from the master
+  /// password is cached by `keys` for subsequent calls.
+  ///
+  /// \param[in,out] keys Session of the master password for store
+  /// \param[in] input Saved store from memory
+  void load(session &keys, std::string const &input);
+
   /// \brief Load store from file.
   ///
-  /// Load a file into memory and use the load() function for decryption of that file's contents.
-  /// Throws an exception if the file cannot be opened, decrypted, or is not of valid format.
+  /// Decrypt a file's contents like the load() function does. The file is memory mapped and
+  /// decrypted straight from the mapped pages in fixed-size chunks, so it is never copied into
+  /// memory as a whole. Throws an exception if the file cannot be opened, decrypted, or is not of
+  /// valid format.
   ///
   /// \param[in] password Master password for store
   /// \param[in] filename Path of store to be decrypted
@@ -59,30 +203,137 @@ struct container
   /// \see save_to_file()
   void load_from_file(std::string const &password, std::string const &filename);
 
+  /// \brief Load store from file, deriving the key with a session.
+  ///
+  /// \param[in,out] keys Session of the master password for store
+  /// \param[in] filename Path of store to be decrypted
+  void load_from_file(session &keys, std::string const &filename);
+
+  /// \brief Serialization formats of the encrypted payload.
+  ///
+  /// The format is detected automatically on load(), so stores can be converted simply by loading
+  /// and saving them again.
+  enum format_type
+  {
+    /// \brief Human readable JSON document, the payload format of all earlier versions.
+    FORMAT_JSON,
+    /// \brief Versioned length-prefixed records, smaller and faster to load.
+    FORMAT_BINARY,
+    /// \brief Individually encrypted elements behind an encrypted index of their summaries.
+    ///
+    /// Loading a segmented store only decrypts the index, which is enough for categories() and
+    /// elements_by_category(). Each element is decrypted on first access by its getter. Note that
+    /// getters are therefore not safe to be called concurrently on segmented stores, unless
+    /// materialize() was called.
+    FORMAT_SEGMENTED
+  };
+
+  /// \brief Decrypt all elements of a segmented store at once.
+  ///
+  /// Elements of a store loaded in FORMAT_SEGMENTED are decrypted on first access. This function
+  /// decrypts all of them up front instead, distributed over several threads, as elements are
+  /// encrypted independently. Afterwards getters are safe to be called concurrently. Does nothing
+  /// for stores of other formats. Throws an exception if an element is corrupted, elements
+  /// decrypted successfully are kept nevertheless.
+  ///
+  /// \param[in] threads Number of threads, one per hardware thread if 0
+  void materialize(std::size_t threads = 0) const;
+
   /// \brief Save to memory.
   ///
   /// Encrypts content of a password store to memory for storing it somewhere. Has no other effects
-  /// on the store.
+  /// on the store, except that small elements other than files are kept serialized in memory until
+  /// they change, so saving again only serializes changed elements. Saves may be called from
+  /// several threads at once, they are carried out one after another.
   ///
   /// \param[in] password Master password for store
+  /// \param[in] format Serialization format of the payload
   /// \return Encrypted data
   ///
   /// \see save_to_file()
   /// \see load()
-  std::string save(std::string const &password) const;
+  std::string save(std::string const &password, format_type format = FORMAT_JSON) const;
+
+  /// \brief Save to memory, deriving the key with a session.
+  ///
+  /// \param[in,out] keys Session of the master password for store
+  /// \param[in] format Serialization format of the payload
+  /// \return Encrypted data
+  std::string save(session &keys, format_type format = FORMAT_JSON) const;
 
   /// \brief Save to file.
   ///
-  /// Saves content of a store to memory using the save() function and then writes the encrypted
-  /// data to disk for further usage. Throws an exception if the data could not be written to disk
-  /// successfully. Will silently overwrite if such a file exists already.
+  /// Encrypts content of a store like the save() function does and writes the encrypted data to
+  /// disk for further usage. Serialization, encryption and writing run in fixed-size chunks, so the
+  /// encrypted store is never held in memory as a whole. Throws an exception if the data could not
+  /// be written to disk successfully. Will silently overwrite if such a file exists already, but
+  /// only once the new store is on disk, so an interrupted save leaves the previous one intact.
   ///
   /// \param[in] password Master password for store
   /// \param[in] filename Path of the store to be encrypted
+  /// \param[in] format Serialization format of the payload
   ///
   /// \see save()
   /// \see load_from_file()
-  void save_to_file(std::string const &password, std::string const &filename) const;
+  void save_to_file(std::string const &password, std::string const &filename,
+                    format_type format = FORMAT_JSON) const;
+
+  /// \brief Save to file, deriving the key with a session.
+  ///
+  /// \param[in,out] keys Session of the master password for store
+  /// \param[in] filename Path of the store to be encrypted
+  /// \param[in] format Serialization format of the payload
+  void save_to_file(session &keys, std::string const &filename,
+                    format_type format = FORMAT_JSON) const;
+
+  /// \brief Change the master password of a store in memory.
+  ///
+  /// Stores are encrypted with a random data key, which is wrapped by the master password in a
+  /// small header. Only this header is rewritten, so the time needed does not depend on the size
+  /// of the store. Stores written by earlier versions lack such a header, and are decrypted and
+  /// encrypted again in their payload format once. Throws an exception if the old password is
+  /// invalid or the store is not of valid format.
+  ///
+  /// \param[in] old_password Current master password for store
+  /// \param[in] new_password New master password for store
+  /// \param[in,out] input Saved store from memory
+  static void change_password(std::string const &old_password, std::string const &new_password,
+                              std::string &input);
+
+  /// \brief Change the master password of a store file.
+  ///
+  /// Like change_password(), but only the header of the file is decrypted, the payload is copied
+  /// unchanged. The file is replaced atomically by a new one synced to disk. Throws an exception if
+  /// the file cannot be accessed, the old password is invalid or the store is not of valid format.
+  ///
+  /// \param[in] old_password Current master password for store
+  /// \param[in] new_password New master password for store
+  /// \param[in] filename Path of store
+  static void change_password_of_file(std::string const &old_password,
+                                      std::string const &new_password,
+                                      std::string const &filename);
+
+  /// \brief Record changes in a journal next to a store file.
+  ///
+  /// The store is saved to the file once, afterwards each element set is appended as a small
+  /// encrypted record to a journal next to it and synced to disk instead of rewriting the whole
+  /// store, see journal. load_from_file() replays the journal of a store file. Once the journal
+  /// grows past `threshold` bytes, it is folded back into the store file by compact(). Saving the
+  /// store to the same file starts an empty journal, while clear() and loading end journal mode.
+  /// Throws an exception if the file or journal cannot be written.
+  ///
+  /// \param[in,out] keys Session of the master password for store
+  /// \param[in] filename Path of the store to be encrypted
+  /// \param[in] format Serialization format of the payload on compaction
+  /// \param[in] threshold Size of the journal in bytes triggering compaction
+  void journal_to_file(session &keys, std::string const &filename,
+                       format_type format = FORMAT_JSON, boost::uint64_t threshold = 1 << 20);
+
+  /// \brief Fold the journal into its store file.
+  ///
+  /// Saves the store to the file given to journal_to_file() and starts an empty journal. Does
+  /// nothing outside of journal mode.
+  void compact();
 
   /// \brief Clears all stored data.
   ///
@@ -113,6 +364,96 @@ struct container
   std::map< std::string, std::string > elements_by_category(content_type t,
                                                             std::string const &cat) const;
 
+  /// \brief Pass the elements of a given content type to a visitor without copying them.
+  ///
+  /// Elements are visited in order of insertion. Pending elements of a segmented store are
+  /// decrypted for the visit without being kept, so a pass does not grow memory use; call
+  /// materialize() first for repeated passes.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] visitor Visitor called for each element until it returns false
+  /// \return Whether all elements were visited
+  bool visit(content_type t, element_visitor &visitor) const;
+
+  /// \brief Pass the elements of a category to a visitor without copying them.
+  ///
+  /// Like visit(content_type, element_visitor &) const, but only for elements of category `cat`.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] cat Category to visit
+  /// \param[in] visitor Visitor called for each element until it returns false
+  /// \return Whether all elements were visited
+  bool visit(content_type t, std::string const &cat, element_visitor &visitor) const;
+
+  /// \brief Pass the unique ids and titles of a category to a visitor without copying them.
+  ///
+  /// The same as elements_by_category(), but straight from the category index of the store. No
+  /// element is decrypted, and nothing is allocated.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] cat Category to visit
+  /// \param[in] visitor Visitor called for each element until it returns false
+  /// \return Whether all elements were visited
+  bool visit_titles(content_type t, std::string const &cat, title_visitor &visitor) const;
+
+  /// \brief Search elements of a given content type by substring.
+  ///
+  /// Finds all elements with `query` contained in one of their searchable fields, ignoring the case
+  /// of ASCII letters. Logins are searched by title, username and url, notes by title and content,
+  /// files by title, and contacts by all fields except unique id and category. A trigram index of
+  /// these fields is built on the first search of a content type, which decrypts all elements of a
+  /// segmented store, and is kept up to date by the setters afterwards.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] query Text to search for
+  /// \return Map of matching elements (unique id to title)
+  std::map< std::string, std::string > search(content_type t, std::string const &query) const;
+
+  /// \brief List elements of a given content type by title prefix, one page at a time.
+  ///
+  /// Matching ignores the case of ASCII letters, and matches are ordered by title and then by
+  /// unique id, so an exact match comes before longer titles. A sorted index of titles is built on
+  /// the first query of a content type and kept up to date by the setters afterwards. It only needs
+  /// the titles, so elements of a segmented store stay encrypted.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] prefix Beginning of the title, the empty prefix matches all elements
+  /// \param[in] count Maximum number of elements to return
+  /// \param[in,out] cursor Empty for the first page, afterwards set to continue with the next page
+  /// or emptied if there is none
+  /// \return Matching elements (unique id and title) in order
+  std::vector< std::pair< std::string, std::string > > titles_by_prefix(
+      content_type t, std::string const &prefix, std::size_t count, std::string &cursor) const;
+
+  /// \brief Ways the url of a login may match a page, see logins_by_url().
+  enum match_type
+  {
+    /// \brief Same host only.
+    MATCH_HOST,
+    /// \brief Same host, or a parent domain of the page down to its registrable domain.
+    MATCH_PARENT_DOMAINS,
+    /// \brief Any host within the registrable domain of the page.
+    ///
+    /// Registrable domains are approximated, so on hosting services sharing a domain between
+    /// their users like `github.io`, logins of one user's site are offered on any other.
+    MATCH_DOMAIN
+  };
+
+  /// \brief Find logins to offer on a page.
+  ///
+  /// Logins are matched by the host of their url, ignoring user information, port, path and the
+  /// case of letters. Logins with an `https` url are not offered on pages of another scheme, so
+  /// their passwords are never filled into unencrypted pages. The registrable domain of a host is
+  /// approximated by its last two labels, or its last three labels under common country code second
+  /// levels like `co.uk`, see MATCH_DOMAIN. An index of hosts is built on the first lookup, which
+  /// decrypts all logins of a segmented store, and is kept up to date by the setters afterwards.
+  ///
+  /// \param[in] url Url of the page
+  /// \param[in] match Kind of match
+  /// \return Map of matching logins (unique id to title)
+  std::map< std::string, std::string > logins_by_url(std::string const &url,
+                                                     match_type match = MATCH_PARENT_DOMAINS) const;
+
   /// \brief Get element by unique id
   ///
   /// Throws an exception if no element is found by the given id.
@@ -185,11 +526,198 @@ struct container
   /// \return Assigned unique id of the stored element
   std::string contact(contact_type const &value);
 
+  /// \brief Add many new elements at once
+  ///
+  /// All elements must have empty unique ids, otherwise an exception is thrown before anything is
+  /// added. Either all elements are added, or none if an exception is thrown. The fields of the
+  /// elements are taken over by exchanging them, which leaves empty elements in `values`, and are
+  /// given back if adding fails. Unique ids come from a single generator seeded once per call, and
+  /// storage for all elements is reserved up front.
+  ///
+  /// \param[in,out] values Elements to be stored
+  /// \return Assigned unique ids in the order of `values`
+  std::vector< std::string > insert(std::vector< login_type > &values);
+
+  /// \brief Add many new elements at once, see insert(std::vector< login_type > &).
+  std::vector< std::string > insert(std::vector< note_type > &values);
+
+  /// \brief Add many new elements at once, see insert(std::vector< login_type > &).
+  std::vector< std::string > insert(std::vector< file_type > &values);
+
+  /// \brief Add many new elements at once, see insert(std::vector< login_type > &).
+  std::vector< std::string > insert(std::vector< contact_type > &values);
+
+  /// \brief Export all elements of a given content type as CSV
+  ///
+  /// The first row names the persisted fields of the content type, every further row holds one
+  /// element. File content is base64 encoded. Elements are written one at a time, and pending
+  /// elements of a segmented store are decrypted for writing without being kept, so memory use does
+  /// not grow with the size of the store.
+  ///
+  /// \param[in] t Content type
+  /// \param[out] output Stream to write to
+  /// \return Number of exported elements
+  std::size_t export_csv(content_type t, std::ostream &output) const;
+
+  /// \brief Import elements of a given content type from CSV
+  ///
+  /// The first row names the fields held by the columns of the further rows, like written by
+  /// export_csv(). Unknown columns are ignored, fields without column are left empty. Elements get
+  /// new unique ids like with insert(). Rows are read one at a time and added in batches, so memory
+  /// use only grows by the imported elements. Either all elements are imported, or none if an
+  /// exception is thrown.
+  ///
+  /// \param[in] t Content type
+  /// \param[in] input Stream to read from
+  /// \return Number of imported elements
+  std::size_t import_csv(content_type t, std::istream &input);
+
+  /// \brief Export all elements as JSON Lines
+  ///
+  /// Every line holds one element as JSON object, starting with a `type` member of `login`, `note`,
+  /// `file` or `contact` followed by the fields of the element like in FORMAT_JSON. Memory use is
+  /// bounded like with export_csv().
+  ///
+  /// \param[out] output Stream to write to
+  /// \return Number of exported elements
+  std::size_t export_json_lines(std::ostream &output) const;
+
+  /// \brief Import elements from JSON Lines
+  ///
+  /// Reads lines like written by export_json_lines(), the `type` member has to come first. Unknown
+  /// members are ignored, missing fields are left empty. Otherwise like import_csv().
+  ///
+  /// \param[in] input Stream to read from
+  /// \return Number of imported elements
+  std::size_t import_json_lines(std::istream &input);
+
 private:
-  std::vector< login_type > logins;
-  std::vector< note_type > notes;
-  std::vector< file_type > files;
-  std::vector< contact_type > contacts;
+  /// \brief Deserialize a store from decrypted `input`.
+  void load(std::streambuf &input);
+  /// \brief Serialize and encrypt the store streamed to `output`.
+  void save(session &keys, std::streambuf &output, format_type format) const;
+
+  /// \brief Encrypted segments of a store backing elements that are not yet decrypted.
+  struct vault;
+
+  /// \brief Load the index of a segmented store, see FORMAT_SEGMENTED.
+  void load(boost::shared_ptr< vault > const &source);
+
+  template < typename T >
+  struct storage;
+
+  /// \brief Journal of a store file changes are recorded in, see journal_to_file().
+  struct journal_state;
+
+  /// \brief Start an empty journal for the store file of `state` as just saved with `keys`.
+  static void restart(journal_state &state, session &keys);
+  /// \brief Apply the records of the journal of a store file with the given data key.
+  void replay(std::string const &key, std::string const &filename);
+  /// \brief Append an element just set to the journal, compacting it if it grew too large.
+  template < typename T >
+  void record(content_type type, T const &value);
+  /// \brief Append the elements from position `first` on just added to the journal, compacting
+  /// it at most once.
+  template < typename T >
+  void record(content_type type, storage< T > const &source, std::size_t first);
+  /// \brief Add the logins from position `first` on just added to the url index, if built.
+  void index_urls(std::size_t first);
+
+  /// \brief Position and size of an encrypted segment within a vault.
+  typedef std::pair< boost::uint64_t, boost::uint64_t > segment;
+
+  /// \brief Elements of a single content type together with their lookup structures.
+  template < typename T >
+  struct storage
+  {
+    storage() : records_json(false) {}
+
+    /// \brief Rebuild all lookup structures after `elements` was filled by load().
+    void rebuild();
+    /// \brief Lookup by unique id, throws if there is no such element.
+    T const &get(std::string const &uid) const;
+    /// \brief Decrypt an element still pending in `source`.
+    void materialize(std::size_t slot) const;
+    /// \brief Decrypt all elements still pending in `source` on up to `threads` threads.
+    void materialize_all(std::size_t threads) const;
+    /// \brief Insert or update an element, see container::login(login_type const &).
+    std::string set(T const &value);
+    /// \brief Insert or update an element keeping its unique id, used by journal replay.
+    void restore(T const &value);
+    /// \brief Insert new elements all or nothing, see container::insert().
+    std::vector< std::string > insert(std::vector< T > &values);
+    /// \brief Remove the elements after the first `size` again, used to undo imports.
+    void truncate(std::size_t size);
+    /// \brief Element at a position, decrypted into `scratch` rather than kept if pending.
+    T const &peek(std::size_t slot, T &scratch) const;
+    /// \brief Write all elements, see container::export_csv().
+    std::size_t write_csv(std::ostream &output) const;
+    /// \brief Add elements, see container::import_csv().
+    std::size_t read_csv(std::streambuf &input);
+    /// \brief Write all elements, see container::export_json_lines().
+    std::size_t write_lines(std::ostream &output, char const *type) const;
+    /// \brief Read the remaining members of a line into `batch`, inserting full batches.
+    void read_line(json::reader &input, std::vector< T > &batch);
+    /// \brief Cache of serialized elements in the given payload format for save().
+    std::vector< std::string > &serialized(bool json) const;
+    /// \brief Remove all elements.
+    void clear();
+    /// \brief Add an element to the category index.
+    void index(T const &value);
+    /// \brief Remove an element from the category index.
+    void unindex(T const &value);
+    /// \brief Categories in use, see container::categories().
+    std::set< std::string > categories() const;
+    /// \brief Pass all elements or those of category `cat` to a visitor, see container::visit().
+    bool visit(std::string const *cat, element_visitor &visitor) const;
+    /// \brief Pass unique ids and titles of a category, see container::visit_titles().
+    bool visit_titles(std::string const &cat, title_visitor &visitor) const;
+    /// \brief Elements of a category, see container::elements_by_category().
+    std::map< std::string, std::string > elements_by_category(std::string const &cat) const;
+    /// \brief Elements matching a query, see container::search().
+    std::map< std::string, std::string > search(std::string const &query) const;
+    /// \brief Elements by title prefix, see container::titles_by_prefix().
+    std::vector< std::pair< std::string, std::string > > titles_by_prefix(
+        std::string const &prefix, std::size_t count, std::string &cursor) const;
+
+    /// \brief Elements in order of insertion.
+    ///
+    /// Elements still pending are summaries only, and are completed by materialize() on access.
+    mutable std::vector< T > elements;
+    /// \brief Position of an element in `elements` by its unique id.
+    boost::unordered_map< std::string, std::size_t > slots;
+    /// \brief Unique ids and titles of all elements by category, empty categories are dropped.
+    std::map< std::string, std::map< std::string, std::string > > by_category;
+    /// \brief Segments of elements not yet decrypted by position in `elements`.
+    mutable boost::unordered_map< std::size_t, segment > pending;
+    /// \brief Vault holding the pending segments.
+    boost::shared_ptr< vault > source;
+    /// \brief Serialized elements by position in `elements`, empty where not serialized since the
+    /// last change or not cacheable, see serialization::cached_record(). Guarded by `saving`.
+    mutable std::vector< std::string > records;
+    /// \brief Whether `records` holds JSON objects rather than binary records.
+    mutable bool records_json;
+    /// \brief Trigram index of the searchable fields, built by search() on first use.
+    ///
+    /// Copies of a store share the index until one of them changes, which then drops its own.
+    mutable boost::shared_ptr< ::search::index > text;
+    /// \brief Sorted index of titles, built by titles_by_prefix() on first use and shared like
+    /// `text`.
+    mutable boost::shared_ptr< ::search::prefix_index > titles;
+  };
+
+  storage< login_type > logins;
+  storage< note_type > notes;
+  storage< file_type > files;
+  storage< contact_type > contacts;
+  /// \brief Journal changes are recorded in, empty outside of journal mode.
+  boost::shared_ptr< journal_state > journaling;
+  /// \brief Held by save() while it updates the serialized elements, see storage::records.
+  mutable boost::mutex saving;
+  /// \brief Hosts of the login urls, built by logins_by_url() on first use.
+  ///
+  /// Copies of a store share the index until one of them changes, which then drops its own.
+  mutable boost::shared_ptr< ::autofill::index > urls;
 };
 
 /// \brief Login credential storage.
@@ -215,6 +743,20 @@ struct login_type
   void generate_password(std::size_t length, std::string const &special_characters =
                                                  "!@#$%^&*()`~-_=+[{]}\\|;:'\",<.>/?");
 
+  /// \brief Generate many random passwords at once.
+  ///
+  /// Passwords are made like by generate_password(std::size_t, std::string const &), but all of
+  /// them are drawn from a single generator, which is considerably faster when rotating many
+  /// passwords in one batch.
+  ///
+  /// \param[in] count Number of passwords
+  /// \param[in] length Desired password length
+  /// \param[in] special_characters Additional alphabet of special characters
+  /// \return Generated passwords
+  static std::vector< std::string > generate_passwords(
+      std::size_t count, std::size_t length,
+      std::string const &special_characters = "!@#$%^&*()`~-_=+[{]}\\|;:'\",<.>/?");
+
   /// \brief Unique id to be managed by the parent store.
   std::string uid;
 
@@ -267,8 +809,7 @@ struct file_type
 
   /// \brief Store binary data from file on disk, optionally removing the file afterwards.
   ///
-  /// A file's content will be stored into the `content` field (please note that the file is
-  /// base64 encoded, so do not attempt to use the file content directly). If desired the source
+  /// A file's content will be stored into the `content` field as it is. If desired the source
   /// file is securely erased from disk after successful storage. An exception is thrown if the
   /// file's content could not be stored, or the file could not be erased.
   ///
@@ -277,6 +818,15 @@ struct file_type
   /// \param[in] iterations Number of times the file will be overwritten with random data
   void upload(std::string const &filename, bool secure_erase = false, std::size_t iterations = 10);
 
+  /// \brief Store binary data read from a stream until its end.
+  ///
+  /// The stream is consumed in fixed-size chunks, so no intermediate copy of the data is made.
+  /// `content` is only replaced if the stream could be read completely, an exception is thrown
+  /// otherwise.
+  ///
+  /// \param[in] input Source stream, should be opened in binary mode
+  void upload(std::istream &input);
+
   /// \brief Map binary data as a temporary file to disk or RAM.
   ///
   /// The file will be created in the temporary files location given by the system, and its up to
@@ -286,13 +836,17 @@ struct file_type
   /// otherwise. Throws an exception if the data could not be mapped into a temporary file. The file
   /// is assumed to be mapped while the `mapped_file` field is set, and will not be mapped again.
   ///
+  /// If `in_memory` is requested, the file is kept in RAM on systems supporting it (see
+  /// auxiliary::map_file()), which makes unmap() a cheap release instead of overwriting the file.
+  ///
+  /// \param[in] in_memory Whether to keep the temporary file in RAM if possible
   /// \return Path to temporary file.
-  std::string map();
+  std::string map(bool in_memory = false);
 
   /// \brief Remove temporary file.
   ///
   /// Performs no operation if the binary data is not currently mapped into a temporary file.
-  /// Securely erases the file otherwise.
+  /// Releases in-memory files, and securely erases files on disk otherwise.
   ///
   /// \param[in] iterations Number of times the file will be overwritten with random data
   void unmap(std::size_t iterations = 10);
@@ -304,7 +858,19 @@ struct file_type
   std::string title;
   /// \brief User defined.
   std::string category;
-  /// \brief Base64 encoded binary data set by the map() function.
+  /// \brief Base64 encoded binary data, as persisted by JSON stores.
+  ///
+  /// \return Encoded `content`
+  std::string encoded_content() const;
+
+  /// \brief Decode base64 encoded binary data into `content`.
+  ///
+  /// \param[in] encoded Base64 encoded binary data
+  void encoded_content(std::string const &encoded);
+
+  /// \brief Binary data set by the upload() function.
+  ///
+  /// Kept as raw bytes in memory, it is only base64 encoded when written to a JSON store.
   std::string content;
 
   /// \brief This field is not persisted on save(), and only to be used by map() and unmap().
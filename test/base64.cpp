@@ -0,0 +1,92 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "base64.hpp"
+#include <boost/random/mersenne_twister.hpp>
+#include <string>
+
+/// \brief Plain scalar encoder the vectorized codec is checked against.
+static std::string reference_encode(std::string const &input)
+{
+  static char const alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string output;
+  for (std::size_t k = 0; k < input.size(); k += 3)
+  {
+    unsigned long bits = static_cast< unsigned char >(input[k]) << 16;
+    if (k + 1 < input.size())
+    {
+      bits |= static_cast< unsigned char >(input[k + 1]) << 8;
+    }
+    if (k + 2 < input.size())
+    {
+      bits |= static_cast< unsigned char >(input[k + 2]);
+    }
+    output += alphabet[(bits >> 18) & 0x3F];
+    output += alphabet[(bits >> 12) & 0x3F];
+    output += k + 1 < input.size() ? alphabet[(bits >> 6) & 0x3F] : '=';
+    output += k + 2 < input.size() ? alphabet[bits & 0x3F] : '=';
+  }
+  return output;
+}
+
+static std::string random_blob(boost::mt19937 &rng, std::size_t size)
+{
+  std::string output(size, 0x0);
+  for (std::size_t k = 0; k < size; ++k)
+  {
+    output[k] = static_cast< char >(rng() & 0xFF);
+  }
+  return output;
+}
+
+int main()
+{
+  // Fixed seed, so a failure can be reproduced.
+  boost::mt19937 rng(20160101);
+
+  // Every size around the block sizes of the vectorized codecs, and a few large ones.
+  for (std::size_t size = 0; size < 600; ++size)
+  {
+    std::string const input = random_blob(rng, size);
+    std::string const encoded = base64::encode(input);
+    CHECK(encoded == reference_encode(input));
+    CHECK(encoded.size() == base64::encoded_size(size));
+    CHECK(base64::decode(encoded) == input);
+  }
+  for (std::size_t size = 1 << 16; size < (1 << 20); size = size * 3 + 1)
+  {
+    std::string const input = random_blob(rng, size);
+    std::string const encoded = base64::encode(input);
+    CHECK(encoded == reference_encode(input));
+    CHECK(base64::decode(encoded) == input);
+  }
+
+  // Whitespace is skipped and padding is optional, even in the middle of vectorized blocks.
+  std::string const input = random_blob(rng, 1000);
+  std::string const encoded = reference_encode(input);
+  std::string wrapped;
+  for (std::size_t k = 0; k < encoded.size(); k += 76)
+  {
+    wrapped += encoded.substr(k, 76) + "\r\n";
+  }
+  CHECK(base64::decode(wrapped) == input);
+  CHECK(base64::decode(encoded.substr(0, encoded.find('='))) == input);
+
+  // Decoding in place.
+  std::string buffer = encoded;
+  buffer.resize(base64::decode(&buffer[0], buffer.size(), &buffer[0]));
+  CHECK(buffer == input);
+
+  // Malformed input is rejected wherever it is.
+  for (std::size_t position = 0; position < 200; position += 7)
+  {
+    std::string malformed = encoded;
+    malformed[position] = '*';
+    CHECK_THROWS(base64::decode(malformed), base64::decode_error);
+  }
+  return 0;
+}
@@ -0,0 +1,288 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "base64.hpp"
+#include "auxiliary.hpp"
+#include "aes.hpp"
+#include "walley.hpp"
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmarks of the performance critical paths. Inputs are generated from fixed seeds and each
+// measurement is repeated, reporting the median, so results are comparable between runs.
+
+/// \brief Number of repetitions of each measurement.
+static std::size_t const repetitions = 7;
+
+/// \brief Measurement repeated by run(), `operator()` performs the work once.
+struct benchmark
+{
+  virtual ~benchmark() {}
+  virtual void operator()() = 0;
+};
+
+/// \brief Median duration of `work` in seconds.
+static double measure(benchmark &work)
+{
+  std::vector< double > durations;
+  for (std::size_t k = 0; k < repetitions; ++k)
+  {
+    boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time();
+    work();
+    boost::posix_time::time_duration const duration =
+        boost::posix_time::microsec_clock::universal_time() - start;
+    durations.push_back(static_cast< double >(duration.total_microseconds()) / 1e6);
+  }
+  std::sort(durations.begin(), durations.end());
+  return durations[durations.size() / 2];
+}
+
+/// \brief Measure `work` and report its throughput for `amount` units named `unit`.
+static void run(char const *name, benchmark &work, double amount, char const *unit)
+{
+  double const seconds = measure(work);
+  std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(12) << seconds * 1e3 << " ms" << std::setw(14)
+            << (seconds > 0 ? amount / seconds : 0) << " " << unit << "/s" << std::endl;
+}
+
+static std::string random_blob(boost::mt19937 &rng, std::size_t size)
+{
+  std::string output(size, 0x0);
+  for (std::size_t k = 0; k < size; ++k)
+  {
+    output[k] = static_cast< char >(rng() & 0xFF);
+  }
+  return output;
+}
+
+struct base64_encode : benchmark
+{
+  explicit base64_encode(std::string const &input) : input(input) {}
+  void operator()()
+  {
+    output = base64::encode(input);
+  }
+  std::string const &input;
+  std::string output;
+};
+
+struct base64_decode : benchmark
+{
+  explicit base64_decode(std::string const &input) : input(input) {}
+  void operator()()
+  {
+    output = base64::decode(input);
+  }
+  std::string const &input;
+  std::string output;
+};
+
+static void run_base64(boost::mt19937 &rng)
+{
+  std::string const blob = random_blob(rng, 16 << 20);
+  std::string const text = base64::encode(blob);
+  base64_encode encode(blob);
+  base64_decode decode(text);
+  run("base64 encode 16 MiB", encode, blob.size() / 1048576.0, "MiB");
+  run("base64 decode 16 MiB", decode, blob.size() / 1048576.0, "MiB");
+}
+
+struct single_passwords : benchmark
+{
+  void operator()()
+  {
+    for (std::size_t k = 0; k < 10000; ++k)
+    {
+      auxiliary::generate_password(20);
+    }
+  }
+};
+
+struct batch_passwords : benchmark
+{
+  void operator()()
+  {
+    auxiliary::generate_passwords(10000, 20);
+  }
+};
+
+static void run_passwords()
+{
+  single_passwords single;
+  batch_passwords batch;
+  run("generate_password() x10000", single, 10000, "passwords");
+  run("generate_passwords(10000)", batch, 10000, "passwords");
+}
+
+struct chunked_encrypt : benchmark
+{
+  chunked_encrypt(std::string const &key, std::string const &input, std::size_t threads)
+      : key(key), input(input), threads(threads)
+  {
+  }
+  void operator()()
+  {
+    output.clear();
+    output.reserve(input.size() + input.size() / aes::sealed_chunk_size * aes::tag_size + 64);
+    auxiliary::output_buffer sink(output);
+    aes::chunked_encryptor buffer(key, sink, threads);
+    buffer.sputn(input.data(), input.size());
+    buffer.finish();
+  }
+  std::string const &key;
+  std::string const &input;
+  std::size_t const threads;
+  std::string output;
+};
+
+struct chunked_decrypt : benchmark
+{
+  chunked_decrypt(std::string const &key, std::string const &input, std::size_t threads)
+      : key(key), input(input), threads(threads), output(1 << 16)
+  {
+  }
+  void operator()()
+  {
+    aes::chunked_decryptor buffer(key, input.data(), input.size(), threads);
+    while (buffer.sgetn(&output[0], output.size()) > 0)
+    {
+    }
+  }
+  std::string const &key;
+  std::string const &input;
+  std::size_t const threads;
+  std::vector< char > output;
+};
+
+static void run_chunked(boost::mt19937 &rng)
+{
+  std::string const key = random_blob(rng, 32);
+  std::string const plaintext = random_blob(rng, 64 << 20);
+  std::size_t const threads[] = {1, auxiliary::thread_count(0)};
+  for (std::size_t k = 0; k < (threads[1] > 1 ? 2 : 1); ++k)
+  {
+    chunked_encrypt encrypt(key, plaintext, threads[k]);
+    encrypt();
+    chunked_decrypt decrypt(key, encrypt.output, threads[k]);
+
+    std::ostringstream name;
+    name << "chunked GCM 64 MiB, " << threads[k] << " thread(s)";
+    run((name.str() + " encrypt").c_str(), encrypt, plaintext.size() / 1048576.0, "MiB");
+    run((name.str() + " decrypt").c_str(), decrypt, plaintext.size() / 1048576.0, "MiB");
+  }
+}
+
+/// \brief Store of `count` logins with random passwords.
+static walley::container logins(boost::mt19937 &rng, std::size_t count)
+{
+  walley::container output;
+  std::vector< walley::login_type > values(count);
+  for (std::size_t k = 0; k < count; ++k)
+  {
+    std::ostringstream title;
+    title << "login " << k;
+    values[k].title = title.str();
+    values[k].username = "user";
+    values[k].password = base64::encode(random_blob(rng, 15));
+    values[k].url = "https://" + title.str().substr(6) + ".example.com/";
+  }
+  output.insert(values);
+  return output;
+}
+
+struct materialize : benchmark
+{
+  materialize(walley::session &keys, std::string const &input, std::size_t threads)
+      : keys(keys), input(input), threads(threads)
+  {
+  }
+  void operator()()
+  {
+    walley::container store;
+    store.load(keys, input);
+    store.materialize(threads);
+  }
+  walley::session &keys;
+  std::string const &input;
+  std::size_t const threads;
+};
+
+static void run_materialize(boost::mt19937 &rng)
+{
+  walley::session keys("password", 1000);
+  std::string const saved = logins(rng, 100000).save(keys, walley::container::FORMAT_SEGMENTED);
+  std::size_t const threads[] = {1, auxiliary::thread_count(0)};
+  for (std::size_t k = 0; k < (threads[1] > 1 ? 2 : 1); ++k)
+  {
+    materialize work(keys, saved, threads[k]);
+    std::ostringstream name;
+    name << "materialize 100000 logins, " << threads[k] << " thread(s)";
+    run(name.str().c_str(), work, 100000, "logins");
+  }
+}
+
+struct search_index : benchmark
+{
+  explicit search_index(walley::container const &store) : store(store) {}
+  void operator()()
+  {
+    // The copy shares no index yet, so the first search builds one.
+    walley::container copy(store);
+    copy.search(walley::container::TYPE_LOGIN, "login");
+  }
+  walley::container const &store;
+};
+
+struct search_queries : benchmark
+{
+  search_queries(walley::container const &store, std::vector< std::string > const &queries)
+      : store(store), queries(queries)
+  {
+  }
+  void operator()()
+  {
+    for (std::size_t k = 0; k < queries.size(); ++k)
+    {
+      store.search(walley::container::TYPE_LOGIN, queries[k]);
+    }
+  }
+  walley::container const &store;
+  std::vector< std::string > const &queries;
+};
+
+static void run_search(boost::mt19937 &rng)
+{
+  walley::container const store = logins(rng, 100000);
+  std::vector< std::string > queries;
+  for (std::size_t k = 0; k < 1000; ++k)
+  {
+    std::ostringstream query;
+    query << rng() % 100000 << ".exa";
+    queries.push_back(query.str());
+  }
+
+  search_index index(store);
+  run("search index of 100000 logins", index, 100000, "logins");
+  search_queries search(store, queries);
+  search();
+  run("search 1000 queries", search, 1000, "queries");
+}
+
+int main()
+{
+  boost::mt19937 rng(20160101);
+  run_base64(rng);
+  run_passwords();
+  run_chunked(rng);
+  run_materialize(rng);
+  run_search(rng);
+  return 0;
+}
@@ -0,0 +1,46 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#ifndef TEST_CHECK_HPP_INCLUDED
+#define TEST_CHECK_HPP_INCLUDED
+
+#include <cstdlib>
+#include <iostream>
+
+/// \brief Minimal checks for the test programs, which exit with an error on the first failure.
+///
+/// Unlike assert(), checks are evaluated in release builds as well.
+namespace check
+{
+/// \brief Report a failed check and exit.
+inline void fail(char const *condition, char const *file, int line)
+{
+  std::cerr << file << ":" << line << ": check failed: " << condition << std::endl;
+  std::exit(EXIT_FAILURE);
+}
+}
+
+/// \brief Fail unless `condition` holds.
+#define CHECK(condition) ((condition) ? (void)0 : check::fail(#condition, __FILE__, __LINE__))
+
+/// \brief Fail unless `statement` throws an exception of type `error`.
+#define CHECK_THROWS(statement, error)                                                            \
+  do                                                                                              \
+  {                                                                                               \
+    bool _thrown = false;                                                                         \
+    try                                                                                           \
+    {                                                                                             \
+      statement;                                                                                  \
+    }                                                                                             \
+    catch (error const &)                                                                         \
+    {                                                                                             \
+      _thrown = true;                                                                             \
+    }                                                                                             \
+    if (!_thrown)                                                                                 \
+    {                                                                                             \
+      check::fail(#statement " throws " #error, __FILE__, __LINE__);                              \
+    }                                                                                             \
+  } while (false)
+
+#endif // TEST_CHECK_HPP_INCLUDED
@@ -0,0 +1,91 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "aes.hpp"
+#include <boost/random/mersenne_twister.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string random_blob(boost::mt19937 &rng, std::size_t size)
+{
+  std::string output(size, 0x0);
+  for (std::size_t k = 0; k < size; ++k)
+  {
+    output[k] = static_cast< char >(rng() & 0xFF);
+  }
+  return output;
+}
+
+static std::string encrypt(std::string const &key, std::string const &plaintext,
+                           std::size_t threads)
+{
+  std::stringbuf output;
+  aes::chunked_encryptor buffer(key, output, threads);
+  // Odd writes, so chunk boundaries fall within them.
+  for (std::size_t k = 0; k < plaintext.size(); k += 99991)
+  {
+    buffer.sputn(plaintext.data() + k, std::min< std::size_t >(99991, plaintext.size() - k));
+  }
+  buffer.finish();
+  return output.str();
+}
+
+static std::string decrypt(std::string const &key, std::string const &ciphertext,
+                           std::size_t threads)
+{
+  aes::chunked_decryptor buffer(key, ciphertext.data(), ciphertext.size(), threads);
+  std::string output;
+  std::vector< char > chunk(65537);
+  for (std::streamsize read = 0; (read = buffer.sgetn(&chunk[0], chunk.size())) > 0;)
+  {
+    output.append(&chunk[0], static_cast< std::size_t >(read));
+  }
+  return output;
+}
+
+int main()
+{
+  boost::mt19937 rng(20160101);
+  std::string const key = random_blob(rng, 32);
+  std::size_t const chunk = aes::sealed_chunk_size;
+  std::size_t const sealed = chunk + aes::tag_size;
+
+  // Sizes around chunk boundaries, encrypted and decrypted on different numbers of threads.
+  std::size_t const sizes[] = {0, 1, chunk - 1, chunk, chunk + 1, 3 * chunk + 5};
+  for (std::size_t k = 0; k < sizeof(sizes) / sizeof(*sizes); ++k)
+  {
+    std::string const plaintext = random_blob(rng, sizes[k]);
+    for (std::size_t threads = 1; threads <= 4; threads *= 2)
+    {
+      std::string const ciphertext = encrypt(key, plaintext, threads);
+      CHECK(ciphertext == encrypt(key, plaintext, 3));
+      CHECK(decrypt(key, ciphertext, threads) == plaintext);
+      CHECK(decrypt(key, ciphertext, 5 - threads) == plaintext);
+    }
+  }
+
+  std::string const plaintext = random_blob(rng, 3 * chunk + 5);
+  std::string const ciphertext = encrypt(key, plaintext, 2);
+  CHECK(ciphertext.size() == plaintext.size() + 4 * aes::tag_size);
+
+  // Altered chunks, reordered chunks, missing chunks and a wrong key are all detected.
+  for (std::size_t position = 0; position < ciphertext.size(); position += sealed / 2 + 7)
+  {
+    std::string altered = ciphertext;
+    altered[position] ^= 0x01;
+    CHECK_THROWS(decrypt(key, altered, 2), aes::integrity_error);
+  }
+  std::string reordered = ciphertext;
+  reordered.replace(0, sealed, ciphertext, sealed, sealed);
+  reordered.replace(sealed, sealed, ciphertext, 0, sealed);
+  CHECK_THROWS(decrypt(key, reordered, 2), aes::integrity_error);
+  CHECK_THROWS(decrypt(key, ciphertext.substr(0, 3 * sealed), 2), aes::integrity_error);
+  CHECK_THROWS(decrypt(key, ciphertext.substr(0, ciphertext.size() - 1), 2),
+               aes::integrity_error);
+  CHECK_THROWS(decrypt(key, std::string(), 2), aes::integrity_error);
+  CHECK_THROWS(decrypt(random_blob(rng, 32), ciphertext, 2), aes::integrity_error);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "walley.hpp"
+#include <boost/lexical_cast.hpp>
+#include <exception>
+#include <string>
+#include <vector>
+
+using namespace walley;
+
+/// \brief Store with elements of every type, including empty, long and binary fields.
+struct fixture
+{
+  fixture()
+  {
+    for (std::size_t k = 0; k < 50; ++k)
+    {
+      std::string const number = boost::lexical_cast< std::string >(k);
+
+      login_type login;
+      login.title = "login " + number;
+      login.category = k % 2 ? "web" : "";
+      login.username = "user\"\\\n\t" + number;
+      login.password = std::string(k * 7, 'p') + "\xc3\xa4";
+      login.url = "https://example.com/" + number;
+      if (k % 3)
+      {
+        login.last_change = boost::posix_time::ptime(
+            boost::gregorian::date(2016, 1, 1 + k % 28),
+            boost::posix_time::microseconds(static_cast< boost::int64_t >(k) * 123456789));
+      }
+      logins.push_back(store.login(login));
+
+      note_type note;
+      note.title = "note " + number;
+      note.content = std::string(k * 100, 'n');
+      notes.push_back(store.note(note));
+
+      file_type file;
+      file.title = "file " + number;
+      file.content = std::string(k * 1000, '\0') + number;
+      files.push_back(store.file(file));
+
+      contact_type contact;
+      contact.first_name = "first " + number;
+      contact.last_name = "last";
+      contact.email = number + "@example.com";
+      contact.country = k % 5 ? "" : "DE";
+      contacts.push_back(store.contact(contact));
+    }
+  }
+
+  /// \brief Check that `other` holds the same elements as the fixture.
+  void compare(container const &other) const
+  {
+    for (std::size_t k = 0; k < logins.size(); ++k)
+    {
+      login_type const &expected = store.login(logins[k]);
+      login_type const &actual = other.login(logins[k]);
+      CHECK(actual.title == expected.title && actual.category == expected.category);
+      CHECK(actual.username == expected.username && actual.password == expected.password);
+      CHECK(actual.url == expected.url && actual.last_change == expected.last_change);
+
+      CHECK(other.note(notes[k]).title == store.note(notes[k]).title);
+      CHECK(other.note(notes[k]).content == store.note(notes[k]).content);
+
+      CHECK(other.file(files[k]).title == store.file(files[k]).title);
+      CHECK(other.file(files[k]).content == store.file(files[k]).content);
+
+      contact_type const &contact = other.contact(contacts[k]);
+      CHECK(contact.first_name == store.contact(contacts[k]).first_name);
+      CHECK(contact.email == store.contact(contacts[k]).email);
+      CHECK(contact.country == store.contact(contacts[k]).country);
+    }
+    CHECK(other.categories(container::TYPE_LOGIN) == store.categories(container::TYPE_LOGIN));
+  }
+
+  container store;
+  std::vector< std::string > logins;
+  std::vector< std::string > notes;
+  std::vector< std::string > files;
+  std::vector< std::string > contacts;
+};
+
+/// \brief Load a store and decrypt all elements, which segmented stores otherwise defer.
+static void load(container &store, std::string const &password, std::string const &input)
+{
+  store.load(password, input);
+  store.materialize();
+}
+
+int main()
+{
+  fixture data;
+  session keys("password", 1000);
+
+  container::format_type const formats[] = {container::FORMAT_JSON, container::FORMAT_BINARY,
+                                             container::FORMAT_SEGMENTED};
+  for (std::size_t k = 0; k < sizeof(formats) / sizeof(*formats); ++k)
+  {
+    std::string const saved = data.store.save(keys, formats[k]);
+
+    container loaded;
+    loaded.load("password", saved);
+    data.compare(loaded);
+    CHECK(loaded.categories(container::TYPE_LOGIN).size() == 2);
+
+    // Segmented stores decrypt their elements on several threads just the same.
+    container parallel;
+    parallel.load(keys, saved);
+    parallel.materialize(4);
+    data.compare(parallel);
+
+    // Saving a loaded store again keeps everything, even through the cached records.
+    container reloaded;
+    reloaded.load(keys, loaded.save(keys, formats[k]));
+    data.compare(reloaded);
+
+    // Any altered byte of header, payload, segments or index, and a wrong password, are detected.
+    for (std::size_t position = 0; position < saved.size(); position += saved.size() / 20 + 1)
+    {
+      std::string altered = saved;
+      altered[position] ^= 0x01;
+      container store;
+      CHECK_THROWS(load(store, "password", altered), std::exception);
+    }
+    container store;
+    CHECK_THROWS(load(store, "Password", saved), std::exception);
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "walley.hpp"
+#include "journal.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace walley;
+
+static std::string read_file(std::string const &filename)
+{
+  std::ifstream file(filename.c_str(), std::ifstream::binary);
+  return std::string(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+}
+
+static void write_file(std::string const &filename, std::string const &data)
+{
+  std::ofstream file(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+  file.write(data.data(), static_cast< std::streamsize >(data.size()));
+}
+
+/// \brief Title of the login `uid` in the store file as loaded with its journal.
+static std::string replayed_title(session &keys, std::string const &filename,
+                                  std::string const &uid)
+{
+  container store;
+  store.load_from_file(keys, filename);
+  return store.login(uid).title;
+}
+
+int main()
+{
+  boost::filesystem::path const directory =
+      boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  boost::filesystem::create_directories(directory);
+  std::string const filename = (directory / "store").string();
+  std::string const log = journal::path(filename);
+  session keys("password", 1000);
+
+  container::format_type const formats[] = {container::FORMAT_JSON, container::FORMAT_BINARY,
+                                             container::FORMAT_SEGMENTED};
+  for (std::size_t f = 0; f < sizeof(formats) / sizeof(*formats); ++f)
+  {
+    container store;
+    login_type login;
+    login.title = "first";
+    std::string const uid = store.login(login);
+    store.journal_to_file(keys, filename, formats[f]);
+    std::string const saved = read_file(filename);
+
+    // Changes are appended to the journal only, and replayed on load.
+    std::vector< std::string > notes;
+    for (std::size_t k = 0; k < 10; ++k)
+    {
+      login = store.login(uid);
+      login.title = "title " + boost::lexical_cast< std::string >(k);
+      store.login(login);
+      note_type note;
+      note.content = std::string(k * 1000, 'n');
+      notes.push_back(store.note(note));
+    }
+    CHECK(read_file(filename) == saved);
+    CHECK(replayed_title(keys, filename, uid) == "title 9");
+    {
+      container replayed;
+      replayed.load_from_file("password", filename);
+      CHECK(replayed.note(notes[9]).content == std::string(9000, 'n'));
+    }
+
+    // Copies do not write to the journal of the original.
+    std::string const complete = read_file(log);
+    {
+      container copy(store);
+      login.title = "copy";
+      copy.login(login);
+    }
+    CHECK(read_file(log) == complete);
+
+    // A torn last record is dropped, as is a zero-filled tail.
+    write_file(log, complete.substr(0, complete.size() - 3));
+    CHECK(replayed_title(keys, filename, uid) == "title 9");
+    write_file(log, complete + std::string(64, '\0'));
+    CHECK(replayed_title(keys, filename, uid) == "title 9");
+
+    // Any other damage is an error rather than a silently shortened history.
+    std::string damaged = complete;
+    damaged[complete.size() / 2] ^= 0x01;
+    write_file(log, damaged);
+    CHECK_THROWS(replayed_title(keys, filename, uid), std::exception);
+    write_file(log, complete);
+
+    // Changing the password keeps the journal, compaction folds it into the store.
+    container::change_password_of_file("password", "changed", filename);
+    {
+      container replayed;
+      replayed.load_from_file("changed", filename);
+      CHECK(replayed.login(uid).title == "title 9");
+    }
+    container::change_password_of_file("changed", "password", filename);
+    store.compact();
+    CHECK(boost::filesystem::file_size(log) < complete.size() / 4);
+    CHECK(replayed_title(keys, filename, uid) == "title 9");
+  }
+
+  boost::filesystem::remove_all(directory);
+  return 0;
+}
@@ -0,0 +1,53 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "auxiliary.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+/// \brief Occurrences of each character in `text`.
+static std::map< char, std::size_t > histogram(std::string const &text)
+{
+  std::map< char, std::size_t > output;
+  for (std::size_t k = 0; k < text.size(); ++k)
+  {
+    ++output[text[k]];
+  }
+  return output;
+}
+
+int main()
+{
+  std::string const letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890";
+
+  CHECK(auxiliary::generate_password(0).empty());
+  CHECK(auxiliary::generate_password(32).size() == 32);
+  CHECK(auxiliary::generate_password(64, "").find_first_not_of(letters) == std::string::npos);
+
+  std::vector< std::string > const batch = auxiliary::generate_passwords(1000, 16, "-_");
+  CHECK(batch.size() == 1000);
+  for (std::size_t k = 0; k < batch.size(); ++k)
+  {
+    CHECK(batch[k].size() == 16);
+    CHECK(batch[k].find_first_not_of(letters + "-_") == std::string::npos);
+  }
+
+  // Repeated special characters are used once, so they are no more likely than any other.
+  auxiliary::password_generator repeated(std::string(100, '#'));
+  std::map< char, std::size_t > const counts = histogram(repeated(63 * 1000));
+  CHECK(counts.size() == 63);
+  CHECK(counts.find('#')->second < 1500);
+
+  // Alphabets of every byte, repeated beyond any range of random values, still terminate.
+  std::string bytes;
+  for (std::size_t k = 0; k < 70000; ++k)
+  {
+    bytes += static_cast< char >(k & 0xFF);
+  }
+  auxiliary::password_generator all(bytes);
+  CHECK(histogram(all(256 * 100)).size() == 256);
+  return 0;
+}
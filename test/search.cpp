@@ -0,0 +1,100 @@
+// Copyright 2016 Nikolas Beisemann <github@beisemann.email>
+// This file is subject to the terms and conditions defined in file 'LICENSE', which is part of this
+// code package.
+
+#include "check.hpp"
+#include "walley.hpp"
+#include <boost/random/mersenne_twister.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace walley;
+
+static std::string lower(std::string text)
+{
+  for (std::size_t k = 0; k < text.size(); ++k)
+  {
+    if (text[k] >= 'A' && text[k] <= 'Z')
+    {
+      text[k] = static_cast< char >(text[k] - 'A' + 'a');
+    }
+  }
+  return text;
+}
+
+/// \brief Text of random words from a small vocabulary, so queries have many partial matches.
+static std::string words(boost::mt19937 &rng, std::size_t count)
+{
+  static char const *const vocabulary[] = {"alpha", "Alpine", "bank", "BANKING", "mail", "email",
+                                           "x", "xy", "mailbox", "ban", "\xc3\xa4pfel", "al"};
+  std::string output;
+  for (std::size_t k = 0; k < count; ++k)
+  {
+    output += (k ? " " : "") + std::string(vocabulary[rng() % 12]);
+  }
+  return output;
+}
+
+/// \brief Notes matching a query by scanning all of them.
+static std::map< std::string, std::string > scan(container const &store,
+                                                 std::vector< std::string > const &uids,
+                                                 std::string const &query)
+{
+  std::map< std::string, std::string > output;
+  for (std::size_t k = 0; k < uids.size(); ++k)
+  {
+    note_type const &note = store.note(uids[k]);
+    if (lower(note.title).find(lower(query)) != std::string::npos ||
+        lower(note.content).find(lower(query)) != std::string::npos)
+    {
+      output[uids[k]] = note.title;
+    }
+  }
+  return output;
+}
+
+int main()
+{
+  boost::mt19937 rng(20160101);
+  container store;
+  std::vector< std::string > uids;
+  for (std::size_t k = 0; k < 500; ++k)
+  {
+    note_type note;
+    note.title = words(rng, 2);
+    note.content = words(rng, rng() % 20);
+    uids.push_back(store.note(note));
+  }
+
+  char const *const queries[] = {"a", "al", "ALP", "alpha b", "mail", "ailbo", "bank",
+                                 "nKin", "x x", "\xc3\xa4", "pfel", "zzz", "", "l e"};
+  for (std::size_t k = 0; k < sizeof(queries) / sizeof(*queries); ++k)
+  {
+    CHECK(store.search(container::TYPE_NOTE, queries[k]) == scan(store, uids, queries[k]));
+  }
+
+  // The index follows changes made after it was built.
+  for (std::size_t k = 0; k < 100; ++k)
+  {
+    note_type note = store.note(uids[k * 5]);
+    note.content = words(rng, 3);
+    store.note(note);
+    note_type added;
+    added.title = words(rng, 1);
+    uids.push_back(store.note(added));
+  }
+  for (std::size_t k = 0; k < sizeof(queries) / sizeof(*queries); ++k)
+  {
+    CHECK(store.search(container::TYPE_NOTE, queries[k]) == scan(store, uids, queries[k]));
+  }
+
+  // Copies share the index until one of them changes.
+  container copy(store);
+  note_type note;
+  note.title = "zzz";
+  copy.note(note);
+  CHECK(copy.search(container::TYPE_NOTE, "zzz").size() == 1);
+  CHECK(store.search(container::TYPE_NOTE, "zzz").empty());
+  return 0;
+}